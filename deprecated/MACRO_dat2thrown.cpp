@@ -5,6 +5,10 @@
 
 // author : Esteban Molina (May 2022)
 
+// Deprecated : the kinematics of this copy drifted from those of dat2tuple (|p| is taken as Sqrt(v.Mag()) and Q2 misses
+// the scattered electron momentum), it is kept as it was. Analyses should not copy the kinematics again but use the
+// RDataFrame functors of thrown/dat2tuple/include/kinematics_functors.h (make lib -> bin/libThrownKinematics.so).
+
 void setBranchesAddresses(TTree* t, Float_t* event_index, Float_t* PID, Float_t* parent_PID, Float_t* Px, Float_t* Py, Float_t* Pz, Float_t* E, Float_t* x, Float_t* y, Float_t* z);
 
 // Constants
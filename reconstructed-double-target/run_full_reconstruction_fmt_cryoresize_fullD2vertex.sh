@@ -107,10 +107,14 @@ fi
 lepto_out=lepto_out_${id}
 
 # Setting the vertex
-cp ${rec_utils_dir}/*.py .
-rdm=$(python random_gen.py)
-z_vertex=$(python vertex.py ${lD2_length} ${rdm} ${target})
-echo "Vertex is Z = ${z_vertex}(cm)"
+# dat2tuple samples the vertex of every event inside the cryotarget, keyed by the job id so reruns give the same vertices
+if [ "${target}" == "D2" ]
+then
+    vertex_options="--lD2_length=${lD2_length} --job_id=$((SLURM_ARRAY_JOB_ID*1000000 + SLURM_ARRAY_TASK_ID))"
+else
+    vertex_options="--z_vertex=5."
+fi
+echo "Vertex options : ${vertex_options}"
 
 # Copy lepto executable to temp folder
 cp ${LEPTO_dir}/lepto.exe ${temp_dir}/lepto_${id}.exe
@@ -123,14 +127,12 @@ echo "Target assignation done!"
 # EXECUTE LEPTO
 lepto_${id}.exe < lepto_input.txt > ${lepto_out}.txt
 echo "LEPTO execution done"
-# Transform lepto's output to dat files
-cp ${lepto2dat_dir}/lepto2dat.pl ${temp_dir}/
-perl lepto2dat.pl ${z_vertex} < ${lepto_out}.txt > ${lepto_out}.dat
-echo "lepto2dat done"
-# Transform's dat files into ROOT NTuples
+# Transform lepto's output directly into ROOT NTuples (no intermediate dat file)
+# The LUND file used by GEMC is written in the same pass, with the same vertices
+LUND_lepto_out=LUND${lepto_out}
 echo "dat2tuple start"
 cp ${dat2tuple_dir}/bin/dat2tuple ${temp_dir}/
-./dat2tuple ${lepto_out}.dat ${lepto_out}_ntuple.root
+./dat2tuple ${lepto_out}.txt ${lepto_out}_ntuple.root --input=lepto ${vertex_options} --lund=${LUND_lepto_out}.dat --beam_energy=${beam_energy}
 echo "Finished LEPTO"
 
 ###########################################################################
@@ -148,12 +150,6 @@ fi
 gemc_out=gemc_out_${id}_${target_variation}_s${solenoid}_t${torus}_fmt${fmt_variation}
 gcard_name=clas12_fmt_cryoresize
 
-# Transform lepto's output to LUND format
-# Yes, It is necessary to specify the same z_vertex again
-LUND_lepto_out=LUND${lepto_out}
-cp ${rec_utils_dir}/leptoLUND.pl ${temp_dir}/
-perl leptoLUND.pl ${z_vertex} ${beam_energy} < ${lepto_out}.txt > ${LUND_lepto_out}.dat
-
 # Copy the gcard you'll use into the temp folder and set the torus value
 cp ${rec_utils_dir}/${gcard_name}.gcard ${temp_dir}/
 cp /group/clas12/gemc/4.4.2/experiments/clas12/micromegas/micromegas__bank.txt ${temp_dir}/
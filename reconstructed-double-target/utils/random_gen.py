@@ -1,2 +0,0 @@
-import random
-print(random.random())
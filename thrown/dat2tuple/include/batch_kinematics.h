@@ -0,0 +1,253 @@
+// Batched kinematics engine
+// Takes blocks of electron/hadron momenta in structure-of-arrays layout and computes the same
+// variables as LeptonicKinematics and HadronicKinematics with loops the compiler can vectorize
+// (build with SIMD_FLAGS, see the Makefile). Transcendental functions are replaced by closed
+// forms and a branchless atan2, so every kernel is a straight sequence of arithmetic and selects.
+// The per-particle classes in kinematics.h stay as the reference implementation.
+
+// author : Esteban Molina
+
+#ifndef BATCH_KINEMATICS_H
+#define BATCH_KINEMATICS_H
+
+#include "constants.h"
+
+#include <cmath>
+#include <vector>
+
+//####################################################################################################################//
+//########################################      VECTORIZABLE MATH        #############################################//
+//####################################################################################################################//
+
+// Cephes' rational approximation of atan, written with selects instead of branches : every
+// alternative is computed and the right one picked, so the compiler can if-convert the loop.
+// Relative error below 3e-16 over the whole range.
+inline double batchAtan2(double y, double x){
+  const double kT3P8     = 2.41421356237309504880;  // tan(3pi/8)
+  const double kMoreBits = 6.123233995736765886130E-17;
+
+  double ax = std::fabs(x);
+  double ay = std::fabs(y);
+  // atan of ay/ax in [0, pi/2], avoiding 0/0 when both are zero
+  double t  = ay/((ax + ay == 0.) ? 1. : ax);
+
+  bool   big   = t > kT3P8;
+  bool   mid   = !big && t > 0.66;
+  double r_big = -1./t;
+  double r_mid = (t - 1.)/(t + 1.);
+  double r     = big ? r_big : (mid ? r_mid : t);
+  double y0  = big ? M_PI_2 : (mid ? M_PI_4 : 0.);
+  double y1  = big ? kMoreBits : (mid ? 0.5*kMoreBits : 0.);
+
+  double z = r*r;
+  double P = (((-8.750608600031904122785E-1*z - 1.615753718733365076637E1)*z - 7.500855792314704667340E1)*z
+	      - 1.228866684490136173410E2)*z - 6.485021904942025371773E1;
+  double Q = ((((z + 2.485846490142306297962E1)*z + 1.650270098316988542046E2)*z + 4.328810604912902668951E2)*z
+	      + 4.853903996359136964868E2)*z + 1.945506571482613964425E2;
+  double a = y0 + ((r*z*P/Q + r) + y1);
+
+  // quadrant
+  a = (x < 0.) ? M_PI - a : a;
+  return std::copysign(a, y);
+}
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+// Block of electrons. Inputs are the momentum components, outputs the LeptonicKinematics getters
+class ElectronBlock{
+public:
+  std::vector<double> Px, Py, Pz;
+  std::vector<double> Q2, Xb, Nu, W, y, ThetaLab, PhiLab, P;
+
+  ElectronBlock(int capacity = 4096);
+  ~ElectronBlock();
+
+  int  size()	{return (int) Px.size();}
+  void clear();
+  void push(double px, double py, double pz);
+
+  template<class Run> void compute(const Run& run);
+};
+
+// Block of hadrons, each one with the momentum of the electron of its event.
+// Outputs are the HadronicKinematics getters, plus the leptonic ones of the matching electron
+class HadronBlock{
+public:
+  std::vector<double> Px, Py, Pz, Mass2, PID;
+  ElectronBlock       el;
+  std::vector<double> Zh, Pt2, Pl2, ThetaPQ, PhiPQ, ThetaLab, PhiLab, P;
+
+  HadronBlock(int capacity = 4096);
+  ~HadronBlock();
+
+  int  size()	{return (int) Px.size();}
+  void clear();
+  void push(double px, double py, double pz, double pid, double mass, const double* elP);
+
+  template<class Run> void compute(const Run& run);
+};
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+// Electron block
+
+ElectronBlock::ElectronBlock(int capacity){
+  // Class constructor
+  for(std::vector<double>* v : {&Px, &Py, &Pz, &Q2, &Xb, &Nu, &W, &y, &ThetaLab, &PhiLab, &P}) v->reserve(capacity);
+}
+
+ElectronBlock::~ElectronBlock(){}
+
+void ElectronBlock::clear(){
+  Px.clear();
+  Py.clear();
+  Pz.clear();
+}
+
+void ElectronBlock::push(double px, double py, double pz){
+  Px.push_back(px);
+  Py.push_back(py);
+  Pz.push_back(pz);
+}
+
+template<class Run>
+void ElectronBlock::compute(const Run& run){
+  const int n = size();
+  for(std::vector<double>* v : {&Q2, &Xb, &Nu, &W, &y, &ThetaLab, &PhiLab, &P}) v->resize(n);
+
+  const double* __restrict px = Px.data();
+  const double* __restrict py = Py.data();
+  const double* __restrict pz = Pz.data();
+  double* __restrict q2    = Q2.data();
+  double* __restrict xb    = Xb.data();
+  double* __restrict nu    = Nu.data();
+  double* __restrict w     = W.data();
+  double* __restrict yy    = y.data();
+  double* __restrict theta = ThetaLab.data();
+  double* __restrict phi   = PhiLab.data();
+  double* __restrict p     = P.data();
+
+  const double Ebeam    = run.getEbeam();
+  const double Mtarget  = run.getMtarget();
+  const double Mtarget2 = run.getMtarget2();
+  const double TwoM     = run.get2Mtarget();
+  const double rad2deg  = 180./M_PI;
+
+#pragma omp simd
+  for(int i = 0 ; i < n ; i++){
+    double pt2 = px[i]*px[i] + py[i]*py[i];
+    double P_el = std::sqrt(pt2 + pz[i]*pz[i]);
+    // 4 E P sin^2(theta/2) = 2 E (P - pz), written without cancellation for forward electrons
+    double P_minus_pz_fwd = pt2/(P_el + pz[i]);
+    double P_minus_pz     = (pz[i] > 0.) ? P_minus_pz_fwd : P_el - pz[i];
+
+    p[i]     = P_el;
+    theta[i] = batchAtan2(std::sqrt(pt2), pz[i])*rad2deg;
+    phi[i]   = batchAtan2(py[i], px[i])*rad2deg;
+    q2[i]    = 2.*Ebeam*P_minus_pz;
+    nu[i]    = Ebeam - P_el;
+    xb[i]    = q2[i]/2./Mtarget/nu[i];
+    w[i]     = std::sqrt(Mtarget2 + TwoM*nu[i] - q2[i]);
+    yy[i]    = nu[i]/Ebeam;
+  }
+}
+
+// Hadron block
+
+HadronBlock::HadronBlock(int capacity) : el(capacity){
+  // Class constructor
+  for(std::vector<double>* v : {&Px, &Py, &Pz, &Mass2, &PID, &Zh, &Pt2, &Pl2, &ThetaPQ, &PhiPQ, &ThetaLab, &PhiLab, &P}) v->reserve(capacity);
+}
+
+HadronBlock::~HadronBlock(){}
+
+void HadronBlock::clear(){
+  Px.clear();
+  Py.clear();
+  Pz.clear();
+  Mass2.clear();
+  PID.clear();
+  el.clear();
+}
+
+void HadronBlock::push(double px, double py, double pz, double pid, double mass, const double* elP){
+  Px.push_back(px);
+  Py.push_back(py);
+  Pz.push_back(pz);
+  Mass2.push_back(mass*mass);
+  PID.push_back(pid);
+  el.push(elP[0], elP[1], elP[2]);
+}
+
+template<class Run>
+void HadronBlock::compute(const Run& run){
+  // Leptonic variables first, the hadronic ones need nu and Q2
+  el.compute(run);
+
+  const int n = size();
+  for(std::vector<double>* v : {&Zh, &Pt2, &Pl2, &ThetaPQ, &PhiPQ, &ThetaLab, &PhiLab, &P}) v->resize(n);
+
+  const double* __restrict px  = Px.data();
+  const double* __restrict py  = Py.data();
+  const double* __restrict pz  = Pz.data();
+  const double* __restrict m2  = Mass2.data();
+  const double* __restrict epx = el.Px.data();
+  const double* __restrict epy = el.Py.data();
+  const double* __restrict epz = el.Pz.data();
+  const double* __restrict nu  = el.Nu.data();
+  const double* __restrict q2  = el.Q2.data();
+  double* __restrict zh       = Zh.data();
+  double* __restrict pt2      = Pt2.data();
+  double* __restrict pl2      = Pl2.data();
+  double* __restrict thetapq  = ThetaPQ.data();
+  double* __restrict phipq    = PhiPQ.data();
+  double* __restrict theta    = ThetaLab.data();
+  double* __restrict phi      = PhiLab.data();
+  double* __restrict p        = P.data();
+
+  const double Ebeam   = run.getEbeam();
+  const double rad2deg = 180./M_PI;
+
+#pragma omp simd
+  for(int i = 0 ; i < n ; i++){
+    double hpt2 = px[i]*px[i] + py[i]*py[i];
+    double P2_h = hpt2 + pz[i]*pz[i];
+    double P_h  = std::sqrt(P2_h);
+
+    // virtual photon
+    double qx   = -epx[i];
+    double qy   = -epy[i];
+    double qz   = Ebeam - epz[i];
+    double qt2  = qx*qx + qy*qy;
+    double Q_mag = std::sqrt(qt2 + qz*qz);
+
+    double dot   = px[i]*qx + py[i]*qy + pz[i]*qz;
+    double dot_t = px[i]*qx + py[i]*qy;
+    double cross = qx*py[i] - qy*px[i];	// z component of q x p_h
+
+    // |q x p_h| for the polar angle, more accurate than acos of the cosine
+    double cx = qy*pz[i] - qz*py[i];
+    double cy = qz*px[i] - qx*pz[i];
+    double cross_mag = std::sqrt(cx*cx + cy*cy + cross*cross);
+
+    // cosine as in HadronicKinematics::getCosThetaPQ (|q| from nu and Q2)
+    double cos_pq = dot/(std::sqrt(nu[i]*nu[i] + q2[i])*P_h);
+
+    p[i]       = P_h;
+    theta[i]   = batchAtan2(std::sqrt(hpt2), pz[i])*rad2deg;
+    phi[i]     = batchAtan2(py[i], px[i])*rad2deg;
+    zh[i]      = std::sqrt(m2[i] + P2_h)/nu[i];
+    pt2[i]     = P2_h*(1. - cos_pq*cos_pq);
+    pl2[i]     = P2_h*cos_pq*cos_pq;
+    thetapq[i] = batchAtan2(cross_mag, dot)*rad2deg;
+    // azimuth in the frame where q is the z axis and the electron lies in the xz plane,
+    // both components scaled by |q| qt to avoid the divisions
+    phipq[i]   = batchAtan2(-cross*Q_mag, qt2*pz[i] - qz*dot_t)*rad2deg;
+  }
+}
+
+#endif
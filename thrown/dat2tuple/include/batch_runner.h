@@ -0,0 +1,290 @@
+// Local batch mode (--batch=<manifest>) : the conversions of a whole production run on one node, in one process
+// The manifest has one job per line, "#" starts a comment :
+//   <input> <output> [options]
+//   e.g. lepto_0.txt ntuple_0.root --input=lepto --lund=lund_0.dat --beam_energy=11 --target_mass=1.8756 --z_vertex=-2.5
+// The options of the command line (but --batch, --retries and --threads) come first and apply to every job, those of
+// the line are read after them and replace them. Options with blanks are quoted : --select="Q2>1 && W>2".
+// --threads=<N> jobs run at once, each with one thread unless its line has --threads. Every worker has its own queue of
+// jobs and, once it is empty, steals from the back of the others, so a few long jobs do not leave the other workers idle.
+// ROOT is set up once (ROOT::EnableThreadSafety) and every job keeps its own files, trees and histograms : jobs run as
+// with --stream, their trees are booked in their output file and never in gROOT, which the jobs would share.
+// A job that fails (returns an error or throws) does not stop the others : it is queued again up to --retries=<N> times,
+// then its outputs written by the failed attempt are removed and its line is written to <manifest>.failed.
+// Jobs with --incremental that name the same manifest share its ConversionCache, so a rerun of the batch converts only
+// the failed and changed jobs.
+
+// author : Esteban Molina
+
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include "conversion_cache.h"
+#include "options.h"
+#include "TROOT.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Converts one job, defined in dat2tuple.cpp
+int runJob(Options opt, ConversionCache* cache);
+
+//####################################################################################################################//
+//########################################         DATA RECORDS          #############################################//
+//####################################################################################################################//
+
+struct BatchJob{
+  int              line;	// line of the manifest
+  std::string      text;
+  Options          opt;
+  ConversionCache* cache;
+  int              attempts;
+  int              status;
+  long long        before[3];	// stamps of the outputs before the first attempt
+};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+// Queue of job numbers per worker. The owner takes from the front, the others steal from the back
+class WorkStealingPool{
+  std::vector<std::deque<int>> queues;
+  std::vector<std::mutex>      mutexes;
+  std::atomic<int>             pending;	// jobs queued or running
+
+  bool take(int queue, bool front, int& job);
+
+public:
+  // Jobs are dealt to the workers in turn
+  WorkStealingPool(int n_workers, const std::vector<int>& jobs);
+  ~WorkStealingPool();
+
+  // Next job of the worker, -1 once every job is done
+  int  next(int worker);
+  // The job runs again, it stays pending
+  void retry(int worker, int job);
+  void done()	{pending--;}
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+std::vector<std::string> splitManifestLine(const std::string& line){
+  // Blank separated words, "#" starts a comment and double quotes keep blanks
+  std::vector<std::string> words;
+  std::string word;
+  bool in_word = false, quoted = false;
+  for(char c : line){
+    if(c == '"'){
+      quoted  = !quoted;
+      in_word = true;
+    }
+    else if(!quoted && c == '#') break;
+    else if(!quoted && (c == ' ' || c == '\t' || c == '\r')){
+      if(in_word) words.push_back(word);
+      word.clear();
+      in_word = false;
+    }
+    else{
+      word   += c;
+      in_word = true;
+    }
+  }
+  if(in_word) words.push_back(word);
+  return words;
+}
+
+bool parseJobOptions(const std::vector<std::string>& words, Options& opt){
+  std::vector<char*> argv;
+  for(const std::string& word : words) argv.push_back(const_cast<char*>(word.c_str()));
+  return parseOptions(argv.size(), argv.data(), opt);
+}
+
+long long getOutputStamp(const std::string& file_name){
+  // Modification time of an output, -1 if it does not exist
+  long long bytes, mtime_ns;
+  return (!file_name.empty() && getFileStamp(file_name, bytes, mtime_ns)) ? mtime_ns : -1;
+}
+
+int runBatch(int argc, char** argv, const Options& batch_opt){
+  // Returns 0 if every job was converted
+  std::ifstream manifest(batch_opt.batch);
+  if(!manifest.is_open()){
+    std::cout<<"Could not open "<<batch_opt.batch<<std::endl;
+    return 1;
+  }
+
+  // Options of every job : the command line ones, then those of the line
+  std::vector<std::string> common(1, argv[0]);
+  for(int i = 1 ; i < argc ; i++){
+    std::string arg = argv[i], value;
+    if(getOptionValue(arg, "batch", value) || getOptionValue(arg, "retries", value) || getOptionValue(arg, "threads", value)) continue;
+    common.push_back(arg);
+  }
+
+  std::vector<BatchJob>                    jobs;
+  std::vector<int>                         queued;
+  std::map<std::string, ConversionCache*>  caches;
+  std::set<std::string>                    outputs;
+  std::string line;
+  for(int n = 1 ; std::getline(manifest, line) ; n++){
+    std::vector<std::string> words = splitManifestLine(line);
+    if(words.empty()) continue;
+    BatchJob job = {n, line, Options(), 0, 0, 1, {-1, -1, -1}};
+    bool ok = true;
+    for(const std::string& word : words) ok = ok && word.compare(0, 8, "--batch=") != 0;
+    words.insert(words.begin(), common.begin(), common.end());
+    if(!ok || !parseJobOptions(words, job.opt) || !job.opt.batch.empty() || isPipeInput(job.opt)){
+      std::cout<<batch_opt.batch<<":"<<n<<" is not a job of a file into a file"<<std::endl;
+      ok = false;
+    }
+    // Two jobs writing the same file would corrupt it
+    else if(!outputs.insert(job.opt.file_out).second){
+      std::cout<<batch_opt.batch<<":"<<n<<" writes "<<job.opt.file_out<<" again"<<std::endl;
+      ok = false;
+    }
+    else if(job.opt.incremental){
+      ConversionCache*& cache = caches[getManifestName(job.opt)];
+      if(!cache) cache = new ConversionCache(getManifestName(job.opt));
+      job.cache = cache;
+    }
+    if(ok){
+      // The output file is open before the trees are booked
+      job.opt.stream = true;
+      const std::string* files[3] = {&job.opt.file_out, &job.opt.lund_out, &job.opt.binary_out};
+      for(int k = 0 ; k < 3 ; k++) job.before[k] = getOutputStamp(*files[k]);
+      queued.push_back(jobs.size());
+    }
+    jobs.push_back(job);
+  }
+
+  ROOT::EnableThreadSafety();
+  auto start = std::chrono::steady_clock::now();
+
+  int n_workers = std::max(1, std::min(batch_opt.threads, (int) queued.size()));
+  WorkStealingPool pool(n_workers, queued);
+  std::atomic<int> n_retries(0);
+  std::mutex       print_mutex;
+
+  auto worker = [&](int thread){
+    for(int i = pool.next(thread) ; i >= 0 ; i = pool.next(thread)){
+      BatchJob& job = jobs[i];
+      job.attempts++;
+      auto job_start = std::chrono::steady_clock::now();
+      try{
+	job.status = runJob(job.opt, job.cache);
+      }
+      catch(const std::exception& e){
+	std::lock_guard<std::mutex> lock(print_mutex);
+	std::cout<<job.opt.file_in<<" : "<<e.what()<<std::endl;
+	job.status = 1;
+      }
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job_start).count();
+
+      std::lock_guard<std::mutex> lock(print_mutex);
+      if(job.status == 0){
+	std::cout<<batch_opt.batch<<":"<<job.line<<" "<<job.opt.file_out<<" done in "<<seconds<<" s"<<std::endl;
+	pool.done();
+      }
+      else if(job.attempts <= batch_opt.retries){
+	std::cout<<batch_opt.batch<<":"<<job.line<<" failed, attempt "<<job.attempts + 1<<" of "<<batch_opt.retries + 1<<" queued"<<std::endl;
+	n_retries++;
+	pool.retry(thread, i);
+      }
+      else{
+	// Outputs the failed attempts wrote are not left behind as if they were complete
+	const std::string* files[3] = {&job.opt.file_out, &job.opt.lund_out, &job.opt.binary_out};
+	for(int k = 0 ; k < 3 ; k++){
+	  if(!job.opt.incremental && getOutputStamp(*files[k]) != job.before[k]) std::remove(files[k]->c_str());
+	}
+	std::cout<<batch_opt.batch<<":"<<job.line<<" failed "<<job.attempts<<" times"<<std::endl;
+	pool.done();
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for(int t = 0 ; t < n_workers ; t++) workers.emplace_back(worker, t);
+  for(std::thread& t : workers) t.join();
+  for(auto& cache : caches) delete cache.second;
+
+  // Lines of the failed jobs, to run them again with --batch=<manifest>.failed
+  std::string failed_name = batch_opt.batch + ".failed";
+  std::string failed;
+  int n_done = 0;
+  for(const BatchJob& job : jobs){
+    if(job.status == 0) n_done++;
+    else                failed += job.text + "\n";
+  }
+  if(failed.empty()) std::remove(failed_name.c_str());
+  else{
+    std::ofstream file(failed_name);
+    if(!(file<<failed)) std::cout<<"Could not write "<<failed_name<<std::endl;
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout<<"Batch "<<batch_opt.batch<<" : "<<jobs.size()<<" jobs, "<<n_done<<" converted, "<<jobs.size() - n_done<<" failed, "
+	   <<n_retries<<" retries, "<<n_workers<<" workers, "<<seconds<<" s"<<std::endl;
+  if(n_done != (int) jobs.size()) std::cout<<"The failed jobs are in "<<failed_name<<std::endl;
+
+  return (n_done == (int) jobs.size()) ? 0 : 1;
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+WorkStealingPool::WorkStealingPool(int n_workers, const std::vector<int>& jobs) : queues(n_workers), mutexes(n_workers), pending(jobs.size()){
+  // Class constructor
+  for(size_t i = 0 ; i < jobs.size() ; i++) queues[i%n_workers].push_back(jobs[i]);
+}
+
+WorkStealingPool::~WorkStealingPool(){}
+
+bool WorkStealingPool::take(int queue, bool front, int& job){
+  std::lock_guard<std::mutex> lock(mutexes[queue]);
+  if(queues[queue].empty()) return false;
+  if(front){
+    job = queues[queue].front();
+    queues[queue].pop_front();
+  }
+  else{
+    job = queues[queue].back();
+    queues[queue].pop_back();
+  }
+  return true;
+}
+
+int WorkStealingPool::next(int worker){
+  int n = queues.size();
+  int job;
+  while(true){
+    if(take(worker, true, job)) return job;
+    for(int k = 1 ; k < n ; k++){
+      if(take((worker + k)%n, false, job)) return job;
+    }
+    // Queues empty : done, or a running job may still be queued again
+    if(pending == 0) return -1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+void WorkStealingPool::retry(int worker, int job){
+  // At the back, where an idle worker steals it first
+  std::lock_guard<std::mutex> lock(mutexes[worker]);
+  queues[worker].push_back(job);
+}
+
+#endif
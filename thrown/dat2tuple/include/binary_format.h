@@ -0,0 +1,220 @@
+// Binary event format of the thrown particles, a compact alternative to the .dat text
+// Does not need ROOT : BinaryEventReader can be used on its own by any program (see src/binary_dump.cpp), the definitions
+// are inline so the header can be included in several translation units
+
+// File layout (native byte order, little endian on every farm node)
+//   BinaryHeader                          64 bytes
+//   BinaryParticle[n_particles]           40 bytes each, the particles of an event are contiguous
+//   padding to a multiple of 8 bytes
+//   uint64_t offsets[n_events + 1]        index of the first particle of every event, offsets[n_events] = n_particles
+// The offsets table goes at the end so the file is written in a single pass, its position is in the header.
+// Momenta and vertices are stored as floats : the .dat text keeps 7 decimals, and the ntuples are floats too.
+
+// author : Esteban Molina
+
+#ifndef BINARY_FORMAT_H
+#define BINARY_FORMAT_H
+
+#include "lepto_parser.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char     kBinaryMagic[8] = {'T','H','R','W','N','E','V','1'};
+const uint32_t kBinaryVersion  = 1;
+
+//####################################################################################################################//
+//########################################         DATA RECORDS          #############################################//
+//####################################################################################################################//
+
+struct BinaryHeader{
+  char     magic[8];
+  uint32_t version;
+  uint32_t record_size;		// sizeof(BinaryParticle)
+  uint64_t n_events;
+  uint64_t n_particles;
+  uint64_t offsets_position;	// byte position of the offsets table
+  double   beam_energy;		// GeV
+  uint8_t  reserved[16];
+};
+
+// One row of the .dat format
+struct BinaryParticle{
+  int32_t event_index, PID, parent_PID;
+  float   Px, Py, Pz, E, x, y, z;
+};
+
+static_assert(sizeof(BinaryHeader) == 64,   "BinaryHeader has to be 64 bytes");
+static_assert(sizeof(BinaryParticle) == 40, "BinaryParticle has to be 40 bytes");
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class BinaryEventWriter{
+  FILE*                 out;
+  BinaryHeader          header;
+  std::vector<uint64_t> offsets;
+  int32_t               last_event_index;
+  bool                  failed;		// a write failed
+
+public:
+  BinaryEventWriter(const char* file_name, double beam_energy);
+  ~BinaryEventWriter();
+
+  bool     isOpen()		{return out != nullptr;}
+  uint64_t getNevents()		{return offsets.size();}
+  // Writes the offsets table and the final header and closes the file. False if a write or the close failed (full disk, ...)
+  bool     close();
+
+  // Starts a new event, the next particles go to it
+  void beginEvent();
+  // Adds a particle. Without beginEvent, a new event starts when event_index changes (.dat rows)
+  void addParticle(const ThrownParticle& p);
+  void writeEvent(const ThrownParticle* particles, size_t n);
+  void writeEvent(const std::vector<ThrownParticle>& particles)	{writeEvent(particles.data(), particles.size());}
+};
+
+// Read-only view of a binary file mapped in memory, the records are never copied
+class BinaryEventReader{
+  int                   fd;
+  size_t                size;
+  const char*           data;
+  const BinaryHeader*   header;
+  const BinaryParticle* particles;
+  const uint64_t*       offsets;
+
+public:
+  BinaryEventReader(const char* file_name);
+  ~BinaryEventReader();
+
+  // False if the file could not be mapped or is not a valid binary event file (header and offsets checked when opening)
+  bool     isOpen()		{return header != nullptr;}
+  uint64_t getNevents()		{return header->n_events;}
+  uint64_t getNparticles()	{return header->n_particles;}
+  double   getBeamEnergy()	{return header->beam_energy;}
+
+  // Particles of event i are [getEventBegin(i), getEventEnd(i))
+  const BinaryParticle* getEventBegin(uint64_t i)	{return particles + offsets[i];}
+  const BinaryParticle* getEventEnd(uint64_t i)		{return particles + offsets[i + 1];}
+  uint64_t              getEventSize(uint64_t i)	{return offsets[i + 1] - offsets[i];}
+  const BinaryParticle* getParticles()			{return particles;}
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+inline ThrownParticle toThrownParticle(const BinaryParticle& b){
+  return {b.event_index, b.PID, b.parent_PID, b.Px, b.Py, b.Pz, b.E, b.x, b.y, b.z};
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+inline BinaryEventWriter::BinaryEventWriter(const char* file_name, double beam_energy) : last_event_index(0), failed(false){
+  // Class constructor, the header is written again when closing
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kBinaryMagic, sizeof(kBinaryMagic));
+  header.version     = kBinaryVersion;
+  header.record_size = sizeof(BinaryParticle);
+  header.beam_energy = beam_energy;
+
+  out = std::fopen(file_name, "wb");
+  if(out) failed = std::fwrite(&header, sizeof(header), 1, out) != 1;
+}
+
+inline BinaryEventWriter::~BinaryEventWriter(){
+  close();
+}
+
+inline bool BinaryEventWriter::close(){
+  if(!out) return !failed;
+
+  uint64_t position = sizeof(header) + header.n_particles*sizeof(BinaryParticle);
+  uint64_t padding  = (8 - position%8)%8;
+  const char zeros[8] = {0};
+  if(std::fwrite(zeros, 1, padding, out) != padding) failed = true;
+
+  header.n_events         = offsets.size();
+  header.offsets_position = position + padding;
+  offsets.push_back(header.n_particles);
+  if(std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), out) != offsets.size()) failed = true;
+
+  if(std::fseek(out, 0, SEEK_SET) != 0 || std::fwrite(&header, sizeof(header), 1, out) != 1) failed = true;
+  if(std::fclose(out) != 0) failed = true;
+  out = nullptr;
+  return !failed;
+}
+
+inline void BinaryEventWriter::beginEvent(){
+  offsets.push_back(header.n_particles);
+}
+
+inline void BinaryEventWriter::addParticle(const ThrownParticle& p){
+  if(offsets.empty() || (p.event_index != last_event_index && offsets.back() != header.n_particles)) beginEvent();
+  last_event_index = p.event_index;
+
+  BinaryParticle b = {p.event_index, p.PID, p.parent_PID, (float) p.Px, (float) p.Py, (float) p.Pz, (float) p.E, (float) p.x, (float) p.y, (float) p.z};
+  if(std::fwrite(&b, sizeof(b), 1, out) != 1) failed = true;
+  header.n_particles++;
+}
+
+inline void BinaryEventWriter::writeEvent(const ThrownParticle* particles, size_t n){
+  // event_index is not used to split, LEPTO events may hold several electrons. It is stored as given : the threaded
+  // conversion shifts the rows of every chunk first (parallel_convert.h)
+  beginEvent();
+  for(size_t i = 0 ; i < n ; i++){
+    last_event_index = particles[i].event_index;
+    addParticle(particles[i]);
+  }
+}
+
+inline BinaryEventReader::BinaryEventReader(const char* file_name) : fd(-1), size(0), data(nullptr), header(nullptr), particles(nullptr), offsets(nullptr){
+  // Class constructor
+  fd = open(file_name, O_RDONLY);
+  if(fd < 0) return;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(BinaryHeader)) return;
+  size = st.st_size;
+
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(map == MAP_FAILED) return;
+  data = (const char*) map;
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  const BinaryHeader* h = (const BinaryHeader*) data;
+  if(std::memcmp(h->magic, kBinaryMagic, sizeof(kBinaryMagic)) != 0 || h->version != kBinaryVersion ||
+     h->record_size != sizeof(BinaryParticle)) return;
+  // Unfinished files (writer not closed) have no offsets table. The particles end before the table, which ends in the file
+  if(h->offsets_position < sizeof(BinaryHeader) || h->offsets_position%8 != 0 || h->offsets_position > size ||
+     h->n_particles > (h->offsets_position - sizeof(BinaryHeader))/sizeof(BinaryParticle) ||
+     h->n_events >= (size - h->offsets_position)/sizeof(uint64_t)) return;
+
+  // Offsets from 0 to n_particles, never decreasing, so no event reads past the particles
+  const uint64_t* table = (const uint64_t*) (data + h->offsets_position);
+  if(table[0] != 0 || table[h->n_events] != h->n_particles) return;
+  for(uint64_t i = 0 ; i < h->n_events ; i++){
+    if(table[i + 1] < table[i]) return;
+  }
+
+  particles = (const BinaryParticle*) (data + sizeof(BinaryHeader));
+  offsets   = table;
+  header    = h;
+}
+
+inline BinaryEventReader::~BinaryEventReader(){
+  if(data) munmap((void*) data, size);
+  if(fd >= 0) close(fd);
+}
+
+#endif
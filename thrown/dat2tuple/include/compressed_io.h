@@ -0,0 +1,252 @@
+// Compressed LEPTO listings, .dat rows and LUND files, read and written without a decompressed copy on disk
+//   gzip (.gz) : zlib, in this process
+//   zstd (.zst): the zstd command, in a child process (zstd -dc / zstd -o)
+// Inputs are recognized by their first bytes, whatever their name. They are decompressed by a reader thread (or the
+// zstd process) into a queue of blocks while the main thread parses the previous ones, and are converted as pipes are :
+// in streaming mode with one thread (openCompressedInput of pipe_input.h).
+// Outputs are compressed when their name ends in .gz or .zst. The LUND writer sees a FILE* either way.
+// SIGPIPE is ignored once a zstd output is open : if the zstd process dies, the writes fail and closeOutputFile reports it.
+
+// author : Esteban Molina
+
+#ifndef COMPRESSED_IO_H
+#define COMPRESSED_IO_H
+
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <istream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <zlib.h>
+
+// Blocks of decompressed text handed to the parser, and blocks read ahead
+const size_t kInflateBlock = 1 << 20;
+const size_t kInflateDepth = 4;
+
+enum Compression{kNoCompression = 0, kGzip = 1, kZstd = 2};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+// Decompressed text of a file, filled by a reader thread
+class InflateBuffer : public std::streambuf{
+  gzFile                  gz;
+  FILE*                   process;	// zstd -dc
+  std::thread             reader;
+  std::mutex              mutex;
+  std::condition_variable changed;
+  std::deque<std::string> blocks;
+  std::string             current;
+  bool                    open, done, failed, stop;
+
+  void readBlocks();
+
+protected:
+  int_type underflow() override;
+
+public:
+  InflateBuffer(const std::string& file_name, int compression);
+  ~InflateBuffer();
+
+  bool isOpen()		{return open;}
+  // True if the file could not be read to the end (corrupt or truncated). The text left is read and dropped first
+  bool hasFailed();
+};
+
+class CompressedInput : public std::istream{
+  InflateBuffer buffer;
+
+public:
+  CompressedInput(const std::string& file_name, int compression);
+  ~CompressedInput();
+
+  bool isOpen()		{return buffer.isOpen();}
+  bool hasFailed()	{return buffer.hasFailed();}
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+int getCompression(const std::string& file_name){
+  // Compression of a file from its magic number
+  unsigned char magic[4] = {0, 0, 0, 0};
+  FILE* in = std::fopen(file_name.c_str(), "rb");
+  if(!in) return kNoCompression;
+  size_t n = std::fread(magic, 1, 4, in);
+  std::fclose(in);
+  if(n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return kGzip;
+  if(n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) return kZstd;
+  return kNoCompression;
+}
+
+int getOutputCompression(const std::string& file_name){
+  // Compression of an output from its name
+  auto ends_with = [&](const char* suffix){
+    size_t n = std::strlen(suffix);
+    return file_name.size() > n && file_name.compare(file_name.size() - n, n, suffix) == 0;
+  };
+  if(ends_with(".gz"))  return kGzip;
+  if(ends_with(".zst")) return kZstd;
+  return kNoCompression;
+}
+
+bool hasZstd(){
+  // The zstd command is in the PATH. popen succeeds without it, the shell only fails once the stream is used
+  return std::system("command -v zstd > /dev/null 2>&1") == 0;
+}
+
+std::string quoteShell(const std::string& s){
+  // Single quoted for the zstd command line
+  std::string out = "'";
+  for(char c : s){
+    if(c == '\'') out += "'\\''";
+    else          out += c;
+  }
+  return out + "'";
+}
+
+ssize_t writeGzip(void* cookie, const char* data, size_t n){
+  return gzwrite((gzFile) cookie, data, n);
+}
+
+int closeGzip(void* cookie){
+  return (gzclose((gzFile) cookie) == Z_OK) ? 0 : -1;
+}
+
+FILE* openOutputFile(const std::string& file_name){
+  // fopen(file_name, "w"), compressed according to the name. Closed with closeOutputFile
+  int compression = getOutputCompression(file_name);
+  if(compression == kZstd){
+    if(!hasZstd()){
+      std::cout<<"The zstd command is needed to write "<<file_name<<std::endl;
+      return nullptr;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    return popen(("zstd -q -f -o " + quoteShell(file_name)).c_str(), "w");
+  }
+  if(compression == kGzip){
+    gzFile gz = gzopen(file_name.c_str(), "wb6");
+    if(!gz) return nullptr;
+    gzbuffer(gz, 1 << 18);
+    cookie_io_functions_t functions = {nullptr, writeGzip, nullptr, closeGzip};
+    FILE* out = fopencookie(gz, "w", functions);
+    if(!out) gzclose(gz);
+    return out;
+  }
+  return std::fopen(file_name.c_str(), "w");
+}
+
+int closeOutputFile(FILE* out, const std::string& file_name){
+  // 0 on success : every write went through and the file was closed (a zstd output is complete once the command exits)
+  bool write_error = std::ferror(out);
+  int  status      = (getOutputCompression(file_name) == kZstd) ? pclose(out) : std::fclose(out);
+  return (status == 0 && !write_error) ? 0 : -1;
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+InflateBuffer::InflateBuffer(const std::string& file_name, int compression) : gz(nullptr), process(nullptr), done(false), failed(false),
+									       stop(false){
+  // Class constructor, the reader thread starts right away
+  if(compression == kZstd){
+    if(hasZstd()) process = popen(("zstd -dc " + quoteShell(file_name)).c_str(), "r");
+    else          std::cout<<"The zstd command is needed to read "<<file_name<<std::endl;
+  }
+  else{
+    gz = gzopen(file_name.c_str(), "rb");
+    if(gz) gzbuffer(gz, 1 << 18);
+  }
+  open = gz || process;
+  if(open) reader = std::thread(&InflateBuffer::readBlocks, this);
+}
+
+InflateBuffer::~InflateBuffer(){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  changed.notify_all();
+  if(reader.joinable()) reader.join();
+  if(gz) gzclose(gz);
+  if(process) pclose(process);
+}
+
+void InflateBuffer::readBlocks(){
+  // Reader thread : decompresses blocks while fewer than kInflateDepth wait to be parsed
+  bool ok = true;
+  while(true){
+    std::string block(kInflateBlock, '\0');
+    long n = gz ? gzread(gz, &block[0], block.size()) : (long) std::fread(&block[0], 1, block.size(), process);
+    if(gz && n <= 0){
+      // Truncated or corrupt gzip data
+      int error = Z_OK;
+      gzerror(gz, &error);
+      ok = (n == 0 && error == Z_OK);
+    }
+    // zstd reports a corrupt or truncated input by its exit status
+    if(n <= 0 && process){
+      ok = (pclose(process) == 0);
+      process = nullptr;
+    }
+    block.resize(n > 0 ? n : 0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&](){return stop || blocks.size() < kInflateDepth;});
+    if(stop) return;
+    if(block.empty()){
+      done   = true;
+      failed = !ok;
+      changed.notify_all();
+      return;
+    }
+    blocks.push_back(std::move(block));
+    changed.notify_all();
+  }
+}
+
+bool InflateBuffer::hasFailed(){
+  // The reader thread sets failed when it reaches the end of the file. If the parser stopped before, the blocks left
+  // are dropped until then, and the thread is joined
+  if(!open) return true;
+  std::unique_lock<std::mutex> lock(mutex);
+  while(!done){
+    blocks.clear();
+    changed.notify_all();
+    changed.wait(lock, [&](){return done || !blocks.empty();});
+  }
+  bool result = failed;
+  lock.unlock();
+  if(reader.joinable()) reader.join();
+  return result;
+}
+
+InflateBuffer::int_type InflateBuffer::underflow(){
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [&](){return !blocks.empty() || done;});
+  if(blocks.empty()) return traits_type::eof();
+  current.swap(blocks.front());
+  blocks.pop_front();
+  changed.notify_all();
+  setg(&current[0], &current[0], &current[0] + current.size());
+  return traits_type::to_int_type(current[0]);
+}
+
+CompressedInput::CompressedInput(const std::string& file_name, int compression) : std::istream(nullptr), buffer(file_name, compression){
+  // Class constructor
+  rdbuf(&buffer);
+}
+
+CompressedInput::~CompressedInput(){}
+
+#endif
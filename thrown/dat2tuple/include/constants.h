@@ -1,5 +1,8 @@
+#ifndef CONSTANTS_H
+#define CONSTANTS_H
+
 // Constants
-const double kEbeam		= 11.;
+const double kEbeam		= 11.;		// default beam energy, set another one with --beam_energy
 const double kMassGamma		= 0.000000;
 const double kMassPositron	= 5.109998e-4;
 const double kMassElectron	= 5.109998e-4;
@@ -18,3 +21,5 @@ const double kMassKaonZeroShort	= 0.497614;
 const double kMassEta		= 0.547853;
 const double kMassOmega		= 0.782650;
 const double kMassKaonZero	= 0.497614;
+
+#endif
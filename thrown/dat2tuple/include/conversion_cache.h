@@ -0,0 +1,257 @@
+// Incremental conversion (--incremental [--manifest=<file>])
+// Every output is recorded in a manifest (default : dat2tuple.manifest next to the output) with a key made of the
+// converter version, the hash of its sources (DAT2TUPLE_SOURCE_HASH, set by the Makefile), the options that change
+// the output (beam, target, kinematics, schema, cuts, histograms, ...) and the content hash of every input.
+// A conversion whose output is already in the manifest with the same key, and still on disk with the recorded size,
+// is skipped. Rerunning an array job after changing a kinematics definition, a cut or an input converts again only
+// what changed, and an interrupted batch resumes where it stopped :
+//   the output is written to <output>.part and renamed when the conversion succeeds, and only then recorded.
+// Content hashes are reused while the size and modification time of an input do not change, so checking a
+// converted input reads nothing but the manifest. The manifest is appended under an flock, so array jobs can share it.
+//   input  <hash> <bytes> <mtime_ns> <file>
+//   output <key> <bytes> <file>
+// Later lines replace earlier ones. Paths are stored as given on the command line.
+// The jobs of --batch (batch_runner.h) that name the same manifest share one ConversionCache from several threads.
+
+// author : Esteban Molina
+
+#ifndef CONVERSION_CACHE_H
+#define CONVERSION_CACHE_H
+
+#include "options.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Bumped by hand when the output changes in a way the sources hash does not see (e.g. the ROOT version)
+const int kConverterVersion = 1;
+
+#ifndef DAT2TUPLE_SOURCE_HASH
+#define DAT2TUPLE_SOURCE_HASH "unknown"
+#endif
+
+//####################################################################################################################//
+//########################################        DATA RECORDS           #############################################//
+//####################################################################################################################//
+
+struct InputStamp{
+  std::string hash;
+  long long   bytes;
+  long long   mtime_ns;
+};
+
+struct OutputStamp{
+  std::string key;
+  long long   bytes;
+};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class ConversionCache{
+  std::string                        manifest;
+  std::map<std::string, InputStamp>  inputs;
+  std::map<std::string, OutputStamp> outputs;
+  std::string                        pending;	// input lines of the hashes computed in this run
+  std::mutex                         mutex;	// the files are hashed outside of it
+
+  bool append(const std::string& lines);
+
+public:
+  // Reads the manifest, if it exists
+  ConversionCache(const std::string& manifest);
+  ~ConversionCache();
+
+  // Content hash of a file, "" if it can not be read
+  std::string getInputHash(const std::string& file_name);
+  // Key of the output of opt made from inputs
+  std::string getKey(const Options& opt, const std::vector<std::string>& files);
+
+  bool isCurrent(const std::string& output, const std::string& key);
+  // Appends the output (and the hashes computed) to the manifest
+  bool record(const std::string& output, const std::string& key);
+  // Appends the hashes computed, so inputs touched but not changed are not read again
+  bool savePending();
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+uint64_t mixHash(uint64_t h){
+  // Final mix of MurmurHash3
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+uint64_t hashBytes(const char* data, size_t n, uint64_t h = 0){
+  // 64-bit hash, 8 bytes per step. Not cryptographic : it detects changed inputs, it does not defend against forged ones
+  size_t i = 0;
+  for( ; i + 8 <= n ; i += 8){
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    h ^= word*0x9e3779b97f4a7c15ULL;
+    h  = ((h << 31) | (h >> 33))*0xbf58476d1ce4e5b9ULL;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, data + i, n - i);
+  h ^= tail*0x9e3779b97f4a7c15ULL;
+  return mixHash(h ^ n);
+}
+
+std::string toHex(uint64_t h){
+  char text[17];
+  std::snprintf(text, sizeof(text), "%016llx", (unsigned long long) h);
+  return text;
+}
+
+std::string getManifestName(const Options& opt){
+  // --manifest value, or dat2tuple.manifest in the directory of the output
+  if(!opt.manifest.empty()) return opt.manifest;
+  size_t slash = opt.file_out.find_last_of('/');
+  return (slash == std::string::npos) ? "dat2tuple.manifest" : opt.file_out.substr(0, slash + 1) + "dat2tuple.manifest";
+}
+
+std::string getConfigString(const Options& opt){
+  // Options that change the content of the outputs. --threads, --stream, --reader and the memory and chunk sizes give
+  // the same output and are left out
+  std::ostringstream config;
+  config.precision(17);
+  config<<"version="<<kConverterVersion<<" sources="<<DAT2TUPLE_SOURCE_HASH<<" input="<<opt.input<<" z_vertex="<<opt.z_vertex
+	<<" sample_vertex="<<opt.sample_vertex<<" z_min="<<opt.z_min<<" z_max="<<opt.z_max<<" job_id="<<opt.job_id
+	<<" beam_energy="<<opt.beam_energy<<" beam_energy_text="<<opt.beam_energy_text<<" target_mass="<<opt.target_mass<<" kinematics="<<opt.kinematics<<" merge="<<opt.merge
+	<<" backend="<<opt.backend<<" schema="<<opt.schema<<" precision="<<opt.precision<<" compression="<<opt.compression
+	<<" compression_level="<<opt.compression_level<<" basket_size="<<opt.basket_size<<" auto_flush="<<opt.auto_flush
+	<<" raw="<<opt.raw<<" lund="<<opt.lund_out<<" index="<<opt.index<<" binary="<<opt.binary_out<<" no_ntuples="<<opt.no_ntuples
+	<<" select="<<opt.select<<" histograms="<<opt.histograms;
+  return config.str();
+}
+
+bool getFileStamp(const std::string& file_name, long long& bytes, long long& mtime_ns){
+  struct stat st;
+  if(stat(file_name.c_str(), &st) != 0) return false;
+  bytes    = st.st_size;
+  mtime_ns = (long long) st.st_mtim.tv_sec*1000000000LL + st.st_mtim.tv_nsec;
+  return true;
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+ConversionCache::ConversionCache(const std::string& m) : manifest(m){
+  // Class constructor
+  std::ifstream file(manifest);
+  std::string line;
+  while(std::getline(file, line)){
+    std::istringstream in(line);
+    std::string type, name;
+    if(!(in >> type)) continue;
+    if(type == "input"){
+      InputStamp stamp;
+      if(in >> stamp.hash >> stamp.bytes >> stamp.mtime_ns >> std::ws && std::getline(in, name)) inputs[name] = stamp;
+    }
+    else if(type == "output"){
+      OutputStamp stamp;
+      if(in >> stamp.key >> stamp.bytes >> std::ws && std::getline(in, name)) outputs[name] = stamp;
+    }
+  }
+}
+
+ConversionCache::~ConversionCache(){}
+
+std::string ConversionCache::getInputHash(const std::string& file_name){
+  long long bytes, mtime_ns;
+  if(!getFileStamp(file_name, bytes, mtime_ns)) return "";
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto known = inputs.find(file_name);
+    if(known != inputs.end() && known->second.bytes == bytes && known->second.mtime_ns == mtime_ns) return known->second.hash;
+  }
+
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if(fd < 0) return "";
+  uint64_t h = 0;
+  if(bytes > 0){
+    void* map = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map == MAP_FAILED){
+      close(fd);
+      return "";
+    }
+    madvise(map, bytes, MADV_SEQUENTIAL);
+    h = hashBytes((const char*) map, bytes);
+    munmap(map, bytes);
+  }
+  else h = hashBytes("", 0);
+  close(fd);
+
+  InputStamp stamp = {toHex(h), bytes, mtime_ns};
+  std::lock_guard<std::mutex> lock(mutex);
+  inputs[file_name] = stamp;
+  pending += "input " + stamp.hash + " " + std::to_string(bytes) + " " + std::to_string(mtime_ns) + " " + file_name + "\n";
+  return stamp.hash;
+}
+
+std::string ConversionCache::getKey(const Options& opt, const std::vector<std::string>& files){
+  std::string text = getConfigString(opt);
+  if(!opt.histograms.empty()) text += " histograms_hash=" + getInputHash(opt.histograms);
+  for(const std::string& file : files){
+    std::string hash = getInputHash(file);
+    if(hash.empty()) return "";
+    text += " " + hash;
+  }
+  return toHex(hashBytes(text.data(), text.size()));
+}
+
+bool ConversionCache::isCurrent(const std::string& output, const std::string& key){
+  std::lock_guard<std::mutex> lock(mutex);
+  auto known = outputs.find(output);
+  if(key.empty() || known == outputs.end() || known->second.key != key) return false;
+  long long bytes, mtime_ns;
+  return getFileStamp(output, bytes, mtime_ns) && bytes == known->second.bytes;
+}
+
+bool ConversionCache::append(const std::string& lines){
+  // One write under an exclusive lock, so the lines of concurrent jobs do not mix
+  int fd = open(manifest.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if(fd < 0) return false;
+  bool ok = flock(fd, LOCK_EX) == 0 && write(fd, lines.data(), lines.size()) == (ssize_t) lines.size();
+  flock(fd, LOCK_UN);
+  ok = (close(fd) == 0) && ok;
+  if(ok) pending.clear();
+  return ok;
+}
+
+bool ConversionCache::record(const std::string& output, const std::string& key){
+  long long bytes, mtime_ns;
+  if(key.empty() || !getFileStamp(output, bytes, mtime_ns)) return false;
+  std::lock_guard<std::mutex> lock(mutex);
+  if(!append(pending + "output " + key + " " + std::to_string(bytes) + " " + output + "\n")) return false;
+  outputs[output] = {key, bytes};
+  return true;
+}
+
+bool ConversionCache::savePending(){
+  std::lock_guard<std::mutex> lock(mutex);
+  return pending.empty() || append(pending);
+}
+
+#endif
@@ -0,0 +1,46 @@
+// Row by row reader of the .dat format written by lepto2dat.pl
+// Used by the streaming mode, where the raw tree is never built in memory
+
+// author : Esteban Molina
+
+#ifndef DAT_READER_H
+#define DAT_READER_H
+
+#include "lepto_parser.h"
+
+#include <istream>
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class DatReader{
+  std::istream& in;
+  long          n_rows;
+
+public:
+  DatReader(std::istream& input);
+  ~DatReader();
+
+  // Reads the next row : <event_index> <particle_id> <parent_id> <px> <py> <pz> <E> <x> <y> <z>
+  // Returns false at the end of the input
+  bool nextRow(ThrownParticle& p);
+
+  long getNrows()	{return n_rows;}
+};
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+DatReader::DatReader(std::istream& input) : in(input), n_rows(0){}
+
+DatReader::~DatReader(){}
+
+bool DatReader::nextRow(ThrownParticle& p){
+  if(!(in >> p.event_index >> p.PID >> p.parent_PID >> p.Px >> p.Py >> p.Pz >> p.E >> p.x >> p.y >> p.z)) return false;
+  n_rows++;
+  return true;
+}
+
+#endif
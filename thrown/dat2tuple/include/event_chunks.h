@@ -0,0 +1,93 @@
+// Splitting of an input file into chunks that start at event boundaries
+//   .dat  : an event starts at the row with PID==11 && parent_PID==0
+//   lepto : an event starts at the "Event listing" line
+
+// author : Esteban Molina
+
+#ifndef EVENT_CHUNKS_H
+#define EVENT_CHUNKS_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+//####################################################################################################################//
+//########################################         DATA RECORDS          #############################################//
+//####################################################################################################################//
+
+// Byte range [begin, end) of the input file
+struct InputChunk{
+  long begin, end;
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+bool isEventStart(const std::string& line, const std::string& format){
+  // Returns true if the line is the first one of an event
+  if(format == "lepto") return line.find("Event listing") != std::string::npos;
+
+  // .dat : <event_index> <particle_id> <parent_id> ...
+  const char* c = line.c_str();
+  char* end;
+  std::strtol(c, &end, 10);
+  if(end == c) return false;
+  c = end;
+  long PID = std::strtol(c, &end, 10);
+  if(end == c) return false;
+  c = end;
+  long parent_PID = std::strtol(c, &end, 10);
+  if(end == c) return false;
+  return PID == 11 && parent_PID == 0;
+}
+
+long findEventStart(std::ifstream& file, long offset, long file_size, const std::string& format){
+  // Returns the offset of the first event starting at or after offset (file_size if there is none)
+  file.clear();
+  file.seekg(offset);
+  std::string line;
+  // offset may be in the middle of a line, the first event can only start at the next one
+  if(offset > 0){
+    file.seekg(offset - 1);
+    std::getline(file, line);
+  }
+  long pos = (long) file.tellg();
+  while(pos >= 0 && std::getline(file, line)){
+    if(isEventStart(line, format)) return pos;
+    pos = (long) file.tellg();
+  }
+  return file_size;
+}
+
+std::vector<InputChunk> splitAtEvents(const std::string& file_name, const std::string& format, long chunk_bytes){
+  // Splits the file in chunks of about chunk_bytes that begin at an event boundary.
+  // The first chunk always begins at 0 so nothing before the first event is lost
+  std::vector<InputChunk> chunks;
+  std::ifstream file(file_name, std::ios::binary);
+  if(!file.is_open()) return chunks;
+
+  file.seekg(0, std::ios::end);
+  long file_size = (long) file.tellg();
+
+  long begin = 0;
+  while(begin < file_size){
+    long end = (begin + chunk_bytes >= file_size) ? file_size : findEventStart(file, begin + chunk_bytes, file_size, format);
+    chunks.push_back({begin, end});
+    begin = end;
+  }
+  return chunks;
+}
+
+std::string readChunk(const std::string& file_name, const InputChunk& chunk){
+  // Returns the bytes of the chunk
+  std::string buffer(chunk.end - chunk.begin, '\0');
+  std::ifstream file(file_name, std::ios::binary);
+  file.seekg(chunk.begin);
+  file.read(&buffer[0], buffer.size());
+  buffer.resize(file.gcount());
+  return buffer;
+}
+
+#endif
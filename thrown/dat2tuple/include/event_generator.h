@@ -0,0 +1,264 @@
+// Synthetic LEPTO event generator for the benchmarks (src/gen_events.cpp, src/bench.cpp)
+// Writes "Event listing (summary)" blocks laid out like thrown/lepto2dat/lulist.out : beam, target, virtual photon,
+// scattered electron, quark/diquark lines (with the A/V markers), a string, primary hadrons and resonance decays
+// (pi0 -> gamma gamma, rho0 -> pi+ pi-, omega -> pi+ pi- pi0) so every branch of the parsers is exercised.
+// The physics is only meant to be plausible : DIS electron kinematics in the CLAS12 range and hadrons along the
+// virtual photon with energy fractions zh and gaussian transverse momenta. Does not need ROOT.
+
+// author : Esteban Molina
+
+#ifndef EVENT_GENERATOR_H
+#define EVENT_GENERATOR_H
+
+#include "constants.h"
+#include "lepto_parser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//####################################################################################################################//
+//########################################         DATA RECORDS          #############################################//
+//####################################################################################################################//
+
+struct GeneratedLine{
+  const char* name;
+  char        marker;	// ' ', 'A' or 'V'
+  int         KS, KF, orig;
+  double      Px, Py, Pz, E, m;
+};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class EventGenerator{
+  std::mt19937_64                        gen;
+  std::uniform_real_distribution<double> uniform;
+  std::normal_distribution<double>       gauss;
+  double                                 Ebeam;
+  double                                 multiplicity;
+  std::vector<GeneratedLine>             lines;
+  char                                   buffer[256];
+
+  void sampleElectron(double& Px, double& Py, double& Pz, double& E);
+  void addHadron(int KF, double zh, const double* q_dir, double nu, int orig);
+  void addDecay(int parent, const int* KF, int n);
+
+public:
+  // multiplicity : mean number of primary hadrons per event
+  EventGenerator(unsigned long seed = 12345, double beam_energy = kEbeam, double multiplicity = 4.);
+  ~EventGenerator();
+
+  // Appends the LEPTO listing of a new event to out
+  void generate(std::string& out);
+  // Appends the preamble LEPTO prints before the first event
+  void header(std::string& out);
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+const char* getGeneratedName(int KF){
+  switch(KF){
+  case   211: return "pi+";
+  case  -211: return "pi-";
+  case   111: return "(pi0)";
+  case   321: return "K+";
+  case  -321: return "K-";
+  case  2212: return "p+";
+  case  2112: return "n0";
+  case   113: return "(rho0)";
+  case   223: return "(omega)";
+  case    22: return "gamma";
+  default   : return "X";
+  }
+}
+
+double getGeneratedMass(int KF){
+  switch(KF){
+  case   211: case -211: return kMassPiPlus;
+  case   111: return kMassPiZero;
+  case   321: case -321: return kMassKaonPlus;
+  case  2212: return kMassProton;
+  case  2112: return kMassNeutron;
+  case   113: return 0.77526;
+  case   223: return kMassOmega;
+  default   : return 0.;
+  }
+}
+
+void appendDatRows(std::string& out, const std::vector<ThrownParticle>& particles, int event_offset = 0){
+  // Appends particles as .dat rows, with the format of lepto2dat.pl
+  char row[160];
+  for(const ThrownParticle& p : particles){
+    std::snprintf(row, sizeof(row), "%4d %4d %4d %9.7f %9.7f %9.7f %9.7f %9.7f %9.7f %9.7f\n",
+		  p.event_index + event_offset, p.PID, p.parent_PID, p.Px, p.Py, p.Pz, p.E, p.x, p.y, p.z);
+    out += row;
+  }
+}
+
+int listingToDat(const std::string& listing, double z_vertex, std::string& out, int event_offset = 0){
+  // Converts LEPTO listings to .dat rows with LeptoParser, the same parse as lepto2dat.pl
+  // Returns the last event_index written, to be given as event_offset to the next block
+  std::istringstream in(listing);
+  LeptoParser parser(in, z_vertex);
+  std::vector<ThrownParticle> particles;
+  int last = event_offset;
+  while(parser.nextEvent(particles)){
+    appendDatRows(out, particles, event_offset);
+    if(!particles.empty()) last = particles.back().event_index + event_offset;
+  }
+  return last;
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+EventGenerator::EventGenerator(unsigned long seed, double beam_energy, double mult) :
+  gen(seed), uniform(0., 1.), gauss(0., 1.), Ebeam(beam_energy), multiplicity(mult){
+  // Class constructor
+  lines.reserve(64);
+}
+
+EventGenerator::~EventGenerator(){}
+
+void EventGenerator::sampleElectron(double& Px, double& Py, double& Pz, double& E){
+  // Q2 in [1,8] GeV^2, y in [0.2,0.85] and W > 2 GeV
+  while(true){
+    double Q2 = 1. + 7.*uniform(gen);
+    double y  = 0.2 + 0.65*uniform(gen);
+    double nu = y*Ebeam;
+    double W2 = kMassProton*kMassProton + 2.*kMassProton*nu - Q2;
+    E = Ebeam - nu;
+    double cos_theta = 1. - Q2/(2.*Ebeam*E);
+    if(W2 < 4. || cos_theta < -1.) continue;
+
+    double sin_theta = std::sqrt(1. - cos_theta*cos_theta);
+    double phi       = 2.*M_PI*uniform(gen);
+    Px = E*sin_theta*std::cos(phi);
+    Py = E*sin_theta*std::sin(phi);
+    Pz = E*cos_theta;
+    return;
+  }
+}
+
+void EventGenerator::addHadron(int KF, double zh, const double* q_dir, double nu, int orig){
+  // Hadron with energy zh*nu around the virtual photon direction q_dir
+  double m  = getGeneratedMass(KF);
+  double E  = std::max(zh*nu, m + 0.01);
+  double P  = std::sqrt(E*E - m*m);
+  double Pt = std::min(0.4*std::fabs(gauss(gen)), 0.9*P);
+  double Pl = std::sqrt(P*P - Pt*Pt);
+  double phi = 2.*M_PI*uniform(gen);
+
+  // Basis perpendicular to q_dir
+  double ax = (std::fabs(q_dir[0]) < 0.9) ? 1. : 0., ay = 1. - ax, az = 0.;
+  double ux = ay*q_dir[2] - az*q_dir[1], uy = az*q_dir[0] - ax*q_dir[2], uz = ax*q_dir[1] - ay*q_dir[0];
+  double un = std::sqrt(ux*ux + uy*uy + uz*uz);
+  ux /= un; uy /= un; uz /= un;
+  double vx = q_dir[1]*uz - q_dir[2]*uy, vy = q_dir[2]*ux - q_dir[0]*uz, vz = q_dir[0]*uy - q_dir[1]*ux;
+
+  double c = Pt*std::cos(phi), s = Pt*std::sin(phi);
+  bool   stable = (KF != 111 && KF != 113 && KF != 223);
+  lines.push_back({getGeneratedName(KF), ' ', stable ? 1 : 11, KF, orig,
+		   Pl*q_dir[0] + c*ux + s*vx, Pl*q_dir[1] + c*uy + s*vy, Pl*q_dir[2] + c*uz + s*vz, E, m});
+}
+
+void EventGenerator::addDecay(int parent, const int* KF, int n){
+  // Shares the momentum of the line parent (1-based) among n daughters
+  const GeneratedLine p = lines[parent - 1];
+  double weight[3], total = 0.;
+  for(int i = 0 ; i < n ; i++){
+    weight[i] = 0.5 + uniform(gen);
+    total    += weight[i];
+  }
+  for(int i = 0 ; i < n ; i++){
+    double f = weight[i]/total;
+    double m = getGeneratedMass(KF[i]);
+    double Px = f*p.Px + 0.05*gauss(gen), Py = f*p.Py + 0.05*gauss(gen), Pz = f*p.Pz;
+    double E  = std::sqrt(Px*Px + Py*Py + Pz*Pz + m*m);
+    bool   stable = (KF[i] != 111);
+    lines.push_back({getGeneratedName(KF[i]), ' ', stable ? 1 : 11, KF[i], parent, Px, Py, Pz, E, m});
+  }
+}
+
+void EventGenerator::header(std::string& out){
+  out += " Calling LINIT\n \n\n     A MONTE CARLO GENERATOR FOR DEEP INELASTIC LEPTON-NUCLEON SCATTERING\n";
+  out += "     ====================================================================\n\n";
+  std::snprintf(buffer, sizeof(buffer), " Lepton: type = 11     momentum (px,py,pz) =  0.0000  0.0000 %7.4f GeV\n\n\n", Ebeam);
+  out += buffer;
+}
+
+void EventGenerator::generate(std::string& out){
+  lines.clear();
+
+  double Px_el, Py_el, Pz_el, E_el;
+  sampleElectron(Px_el, Py_el, Pz_el, E_el);
+  double qx = -Px_el, qy = -Py_el, qz = Ebeam - Pz_el, nu = Ebeam - E_el;
+  double q_mag = std::sqrt(qx*qx + qy*qy + qz*qz);
+  double q_dir[3] = {qx/q_mag, qy/q_mag, qz/q_mag};
+
+  lines.push_back({"!e-!",     ' ', 21,   11, 0, 0., 0., Ebeam, Ebeam, kMassElectron});
+  lines.push_back({"!p+!",     ' ', 21, 2212, 0, 0., 0., 0., kMassProton, kMassProton});
+  lines.push_back({"!gamma!",  ' ', 21,   22, 1, qx, qy, qz, nu, -std::sqrt(q_mag*q_mag - nu*nu)});
+  lines.push_back({"e-",       ' ',  1,   11, 1, Px_el, Py_el, Pz_el, E_el, kMassElectron});
+  lines.push_back({"(u)",      ' ', 13,    2, 0, qx, qy, qz, nu, 0.0056});
+  lines.push_back({"(ud_0)",   ' ', 13, 2101, 2, 0., 0., -0.2, 0.64, 0.5793333});
+  lines.push_back({"(u)",      'A', 12,    2, 5, qx, qy, qz, nu, 0.0056});
+  lines.push_back({"(ud_0)",   'V', 11, 2101, 6, 0., 0., -0.2, 0.64, 0.5793333});
+  lines.push_back({"(string)", ' ', 11,   92, 7, qx, qy, qz - 0.2, nu + 0.64, 2.2});
+  const int string_line = 9;
+
+  // Primary hadrons : poisson multiplicity (at least 1) and energy fractions summing to at most 1
+  std::poisson_distribution<int> poisson(multiplicity);
+  int n_hadrons = std::max(1, poisson(gen));
+  const int species[9] = {211, -211, 111, 211, -211, 2212, 321, 113, 223};
+  double z_left = 1.;
+  std::vector<int> unstable;
+  for(int i = 0 ; i < n_hadrons ; i++){
+    int    KF = (i == 0) ? 2212 : species[(int) (9*uniform(gen))];
+    double zh = z_left*(0.1 + 0.5*uniform(gen));
+    z_left   -= zh;
+    addHadron(KF, zh, q_dir, nu, string_line);
+    if(lines.back().KS == 11) unstable.push_back((int) lines.size());
+  }
+
+  // Decays, the daughters of an omega may decay again (pi0)
+  for(size_t i = 0 ; i < unstable.size() ; i++){
+    int parent = unstable[i];
+    int KF     = lines[parent - 1].KF;
+    size_t first = lines.size();
+    if(KF == 111)      {const int d[2] = {22, 22};        addDecay(parent, d, 2);}
+    else if(KF == 113) {const int d[2] = {211, -211};     addDecay(parent, d, 2);}
+    else if(KF == 223) {const int d[3] = {211, -211, 111}; addDecay(parent, d, 3);}
+    for(size_t j = first ; j < lines.size() ; j++){
+      if(lines[j].KS == 11) unstable.push_back((int) j + 1);
+    }
+  }
+
+  out += "                            Event listing (summary)\n\n";
+  out += "    I  particle/jet KS     KF orig    p_x      p_y      p_z       E        m\n\n";
+  double sum[5] = {0., 0., 0., 0., 0.};
+  for(size_t i = 0 ; i < lines.size() ; i++){
+    const GeneratedLine& l = lines[i];
+    std::snprintf(buffer, sizeof(buffer), "%5d  %-10s%c%4d %6d %4d %12.7f %12.7f %12.7f %12.7f %12.7f\n",
+		  (int) i + 1, l.name, l.marker, l.KS, l.KF, l.orig, l.Px, l.Py, l.Pz, l.E, l.m);
+    out += buffer;
+    if(l.KS == 1){
+      sum[0] += l.Px; sum[1] += l.Py; sum[2] += l.Pz; sum[3] += l.E;
+    }
+  }
+  sum[4] = std::sqrt(std::max(0., sum[3]*sum[3] - sum[0]*sum[0] - sum[1]*sum[1] - sum[2]*sum[2]));
+  std::snprintf(buffer, sizeof(buffer), "                   sum: -1.00%14.3f%9.3f%9.3f%9.3f%9.3f\n",
+		sum[0], sum[1], sum[2], sum[3], sum[4]);
+  out += buffer;
+}
+
+#endif
@@ -0,0 +1,288 @@
+// Sidecar event index of the .dat and LUND text files (<file>.idx), to seek to an event without reading the text before it
+// Does not need ROOT : src/event_index.cpp builds, prints and cuts files with it, and dat2tuple writes the index of its
+// LUND output with --index. The definitions are inline so the header can be included in several translation units.
+//   .dat : an event starts at the row of the scattered electron (PID==11 && parent_PID==0)
+//   LUND : an event starts at its header line, the only one without the 14 columns of a particle
+
+// File layout (native byte order)
+//   IndexHeader                  64 bytes
+//   IndexEntry[n_events]         16 bytes each
+// The size and modification time of the text file are in the header : an index older than its file is not used.
+
+// author : Esteban Molina
+
+#ifndef EVENT_INDEX_H
+#define EVENT_INDEX_H
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char     kIndexMagic[8] = {'E','V','T','I','N','D','X','1'};
+const uint32_t kIndexVersion  = 1;
+
+// Format of the indexed text
+enum IndexFormat{kIndexDat = 0, kIndexLund = 1};
+
+//####################################################################################################################//
+//########################################         DATA RECORDS          #############################################//
+//####################################################################################################################//
+
+struct IndexHeader{
+  char     magic[8];
+  uint32_t version;
+  uint32_t format;		// IndexFormat
+  uint64_t n_events;
+  uint64_t n_particles;
+  uint64_t source_bytes;	// size of the text file
+  int64_t  source_mtime_ns;	// modification time of the text file
+  uint8_t  reserved[16];
+};
+
+struct IndexEntry{
+  uint64_t offset;		// byte position of the first line of the event
+  uint32_t n_particles;
+  uint32_t n_lines;		// lines of the event, the LUND header included
+};
+
+static_assert(sizeof(IndexHeader) == 64, "IndexHeader has to be 64 bytes");
+static_assert(sizeof(IndexEntry) == 16,  "IndexEntry has to be 16 bytes");
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class EventIndex{
+  uint32_t                format;
+  uint64_t                n_particles;
+  uint64_t                source_bytes;
+  std::vector<IndexEntry> entries;
+
+public:
+  EventIndex(int format = kIndexDat);
+  ~EventIndex();
+
+  int      getFormat()	const	{return format;}
+  uint64_t getNevents()	const	{return entries.size();}
+  uint64_t getNparticles()	const	{return n_particles;}
+
+  const IndexEntry& getEntry(uint64_t i)	const	{return entries[i];}
+  // Bytes [getBegin(i), getEnd(i)) of the text hold event i
+  uint64_t getBegin(uint64_t i)	const	{return entries[i].offset;}
+  uint64_t getEnd(uint64_t i)	const	{return (i + 1 < entries.size()) ? entries[i + 1].offset : source_bytes;}
+
+  void addEvent(uint64_t offset, uint32_t n_particles, uint32_t n_lines);
+  // Size of the text written so far, the end of the last event
+  void setSize(uint64_t bytes)	{source_bytes = bytes;}
+  // Adds the events of the index of a piece written at byte base of the file (chunks of the parallel conversion)
+  void append(const EventIndex& other, uint64_t base);
+
+  // Scans the text file. format -1 guesses it from the first lines
+  bool build(const std::string& file_name, int format = -1);
+  // Reads the index of file_name. False if it does not exist, or if the file changed after it was written
+  bool read(const std::string& index_name, const std::string& file_name);
+  // Writes the index of file_name, once the file is complete
+  bool write(const std::string& index_name, const std::string& file_name);
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+inline std::string getIndexName(const std::string& file_name){
+  return file_name + ".idx";
+}
+
+inline bool getSourceStamp(const std::string& file_name, uint64_t& bytes, int64_t& mtime_ns){
+  struct stat st;
+  if(stat(file_name.c_str(), &st) != 0) return false;
+  bytes    = st.st_size;
+  mtime_ns = (int64_t) st.st_mtim.tv_sec*1000000000LL + st.st_mtim.tv_nsec;
+  return true;
+}
+
+inline int countColumns(const char* line, const char* end){
+  // Number of blank separated fields of a line
+  int n = 0;
+  bool in_field = false;
+  for( ; line != end ; line++){
+    bool blank = (*line == ' ' || *line == '\t' || *line == '\r');
+    if(!blank && !in_field) n++;
+    in_field = !blank;
+  }
+  return n;
+}
+
+inline bool isDatEventStart(const char* line, const char* end){
+  // <event_index> <particle_id> <parent_id> ... with particle_id 11 and parent_id 0
+  int values[3];
+  for(int i = 0 ; i < 3 ; i++){
+    while(line != end && (*line == ' ' || *line == '\t')) line++;
+    std::from_chars_result r = std::from_chars(line, end, values[i]);
+    if(r.ec != std::errc()) return false;
+    line = r.ptr;
+  }
+  return values[1] == 11 && values[2] == 0;
+}
+
+inline bool loadEventIndex(const std::string& file_name, EventIndex& index){
+  // Sidecar index of the file if it is up to date, otherwise the file is scanned (and the sidecar is not written)
+  return index.read(getIndexName(file_name), file_name) || index.build(file_name);
+}
+
+inline bool readEventRange(const std::string& file_name, const EventIndex& index, uint64_t first, uint64_t last, std::string& text){
+  // Text of the events [first, last)
+  text.clear();
+  if(last > index.getNevents()) last = index.getNevents();
+  if(first >= last) return true;
+
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if(fd < 0) return false;
+  uint64_t begin = index.getBegin(first);
+  text.resize(index.getEnd(last - 1) - begin);
+  size_t done = 0;
+  while(done < text.size()){
+    ssize_t n = pread(fd, &text[done], text.size() - done, begin + done);
+    if(n <= 0) break;
+    done += n;
+  }
+  close(fd);
+  return done == text.size();
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+inline EventIndex::EventIndex(int f) : format(f), n_particles(0), source_bytes(0){}
+
+inline EventIndex::~EventIndex(){}
+
+inline void EventIndex::addEvent(uint64_t offset, uint32_t n, uint32_t n_lines){
+  entries.push_back({offset, n, n_lines});
+  n_particles += n;
+}
+
+inline void EventIndex::append(const EventIndex& other, uint64_t base){
+  for(const IndexEntry& e : other.entries) addEvent(base + e.offset, e.n_particles, e.n_lines);
+  source_bytes = base + other.source_bytes;
+}
+
+inline bool EventIndex::build(const std::string& file_name, int f){
+  entries.clear();
+  n_particles  = 0;
+  source_bytes = 0;
+
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if(fd < 0) return false;
+  struct stat st;
+  if(fstat(fd, &st) != 0){
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  if(size == 0){
+    close(fd);
+    format = (f < 0) ? kIndexDat : f;
+    return true;
+  }
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED) return false;
+  madvise(map, size, MADV_SEQUENTIAL);
+  const char* data = (const char*) map;
+  const char* end  = data + size;
+
+  if(f < 0){
+    // LUND particle lines have 14 columns, .dat rows 10
+    f = kIndexDat;
+    const char* line = data;
+    for(int i = 0 ; i < 2 && line < end ; i++){
+      const char* eol = (const char*) std::memchr(line, '\n', end - line);
+      if(!eol) eol = end;
+      if(countColumns(line, eol) == 14) f = kIndexLund;
+      line = eol + 1;
+    }
+  }
+  format = f;
+
+  // Current event : first line, particles and lines
+  uint64_t offset = 0;
+  uint32_t n = 0, n_lines = 0;
+  bool     open_event = false;
+  for(const char* line = data ; line < end ; ){
+    const char* eol = (const char*) std::memchr(line, '\n', end - line);
+    if(!eol) eol = end;
+    int  n_columns = countColumns(line, eol);
+    bool start     = (format == kIndexLund) ? (n_columns > 0 && n_columns != 14) : isDatEventStart(line, eol);
+    if(start){
+      if(open_event) addEvent(offset, n, n_lines);
+      offset     = line - data;
+      n          = 0;
+      n_lines    = 0;
+      open_event = true;
+    }
+    if(open_event){
+      n_lines++;
+      if(n_columns > 0 && (format == kIndexDat || n_columns == 14)) n++;
+    }
+    line = eol + 1;
+  }
+  if(open_event) addEvent(offset, n, n_lines);
+  source_bytes = size;
+
+  munmap(map, size);
+  return true;
+}
+
+inline bool EventIndex::read(const std::string& index_name, const std::string& file_name){
+  uint64_t bytes;
+  int64_t  mtime_ns;
+  if(!getSourceStamp(file_name, bytes, mtime_ns)) return false;
+
+  FILE* in = std::fopen(index_name.c_str(), "rb");
+  if(!in) return false;
+  IndexHeader header;
+  bool ok = std::fread(&header, sizeof(header), 1, in) == 1 && std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) == 0 &&
+	    header.version == kIndexVersion && header.source_bytes == bytes && header.source_mtime_ns == mtime_ns;
+  if(ok){
+    entries.resize(header.n_events);
+    ok = std::fread(entries.data(), sizeof(IndexEntry), entries.size(), in) == entries.size();
+  }
+  std::fclose(in);
+  if(!ok){
+    entries.clear();
+    return false;
+  }
+  format       = header.format;
+  n_particles  = header.n_particles;
+  source_bytes = header.source_bytes;
+  return true;
+}
+
+inline bool EventIndex::write(const std::string& index_name, const std::string& file_name){
+  IndexHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+  header.version     = kIndexVersion;
+  header.format      = format;
+  header.n_events    = entries.size();
+  header.n_particles = n_particles;
+  if(!getSourceStamp(file_name, header.source_bytes, header.source_mtime_ns)) return false;
+  source_bytes = header.source_bytes;
+
+  FILE* out = std::fopen(index_name.c_str(), "wb");
+  if(!out) return false;
+  bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+	    std::fwrite(entries.data(), sizeof(IndexEntry), entries.size(), out) == entries.size();
+  return (std::fclose(out) == 0) && ok;
+}
+
+#endif
@@ -0,0 +1,160 @@
+// Event schema of the thrown output (--schema=event)
+// One entry per event in ntuple_thrown_events : the scattered electron is stored once and the hadrons of the event
+// are variable-length arrays, instead of repeating the 11 electron quantities in every hadron row.
+//   event/L, Q2, Xb, Nu, W, y, Theta_el, Phi_el, P_el, Px_el, Py_el, Pz_el, vz	electron (float or double)
+//   n_hadrons/I
+//   pid[n_hadrons]/I, Zh, Pt2, Pl2, ThetaPQ, PhiPQ, Theta, Phi, P, Px, Py, Pz	hadrons (float or double arrays)
+// RDataFrame reads the arrays as RVecs : df.Define("zh_pi", "Zh[pid == 211]").
+// The rows are expected in input order (every electron before the hadrons of its event), as all the fillers give them.
+
+// author : Esteban Molina
+
+#ifndef EVENT_OUTPUT_H
+#define EVENT_OUTPUT_H
+
+#include "thrown_output.h"
+#include "TTree.h"
+#include "TBranch.h"
+
+#include <string>
+#include <vector>
+
+const int kNvarsEventHadron = 11;	// hadron columns of the event schema without pid
+
+// Positions in the hadron rows (kHadronBranches) of the hadron columns of the event schema
+const int         kEventHadronVars[kNvarsEventHadron]      = {5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+const char* const kEventElectronBranches[kNvarsElectron]  = {"Q2", "Xb", "Nu", "W", "y", "Theta_el", "Phi_el", "P_el",
+							     "Px_el", "Py_el", "Pz_el", "vz"};
+const char* const kEventHadronBranches[kNvarsEventHadron] = {"Zh", "Pt2", "Pl2", "ThetaPQ", "PhiPQ", "Theta", "Phi", "P",
+							     "Px", "Py", "Pz"};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+template<class Real>
+class EventOutput : public ThrownOutput{
+  bool               open;	// an event is being filled
+  Long64_t           event;
+  Real               vars_el[kNvarsElectron];
+  Int_t              n_hadrons;
+  std::vector<Int_t> pids;
+  std::vector<Real>  vars_h[kNvarsEventHadron];
+  TBranch*           pid_branch;
+  TBranch*           h_branches[kNvarsEventHadron];
+
+  void fillEvent();
+  // Grows the hadron arrays, their branches are given the new addresses
+  void reserve(size_t n);
+
+public:
+  // Creates ntuple_thrown_events (and ntuple_thrown_raw) in the current directory
+  EventOutput(int basket_size, bool write_raw);
+  ~EventOutput();
+
+  void fillHadron(Long64_t event, double PID, const double* vars);
+  void fillElectron(Long64_t event, const double* vars);
+
+  // Fills the last event
+  void flush();
+  // Fills the last event and writes the trees in the current directory
+  void write();
+};
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+template<class Real>
+EventOutput<Real>::EventOutput(int basket_size, bool write_raw) :
+  ThrownOutput(true, sizeof(Real) == sizeof(double)), open(false), event(0), n_hadrons(0), pid_branch(0){
+  // Class constructor
+  const std::string type = (sizeof(Real) == sizeof(double)) ? "/D" : "/F";
+  for(int i = 0 ; i < kNvarsElectron ; i++) vars_el[i] = 0;
+
+  events = new TTree("ntuple_thrown_events","");
+  events->Branch("event", &event, "event/L");
+  for(int i = 0 ; i < kNvarsElectron ; i++) events->Branch(kEventElectronBranches[i], &vars_el[i], (std::string(kEventElectronBranches[i]) + type).c_str());
+  events->Branch("n_hadrons", &n_hadrons, "n_hadrons/I");
+
+  // Room for the usual multiplicities, reserve() makes more if needed
+  const size_t capacity = 32;
+  pids.resize(capacity);
+  for(int i = 0 ; i < kNvarsEventHadron ; i++) vars_h[i].resize(capacity);
+  pid_branch = events->Branch("pid", pids.data(), "pid[n_hadrons]/I");
+  for(int i = 0 ; i < kNvarsEventHadron ; i++){
+    std::string leaf = std::string(kEventHadronBranches[i]) + "[n_hadrons]" + type;
+    h_branches[i] = events->Branch(kEventHadronBranches[i], vars_h[i].data(), leaf.c_str());
+  }
+
+  with_raw = write_raw;
+  if(write_raw) bookRaw();
+
+  if(basket_size > 0){
+    for(TTree* t : {events, raw}){
+      if(t) t->SetBasketSize("*", basket_size);
+    }
+  }
+}
+
+template<class Real>
+EventOutput<Real>::~EventOutput(){}
+
+template<class Real>
+void EventOutput<Real>::reserve(size_t n){
+  if(n <= pids.size()) return;
+  size_t capacity = 2*n;
+  pids.resize(capacity);
+  pid_branch->SetAddress(pids.data());
+  for(int i = 0 ; i < kNvarsEventHadron ; i++){
+    vars_h[i].resize(capacity);
+    h_branches[i]->SetAddress(vars_h[i].data());
+  }
+}
+
+template<class Real>
+void EventOutput<Real>::fillEvent(){
+  FillTimer timer(report, events);
+  events->Fill();
+  n_hadrons = 0;
+  open      = false;
+}
+
+template<class Real>
+void EventOutput<Real>::fillElectron(Long64_t event_index, const double* vars){
+  if(open) fillEvent();
+  event = event_index;
+  for(int i = 0 ; i < kNvarsElectron ; i++) vars_el[i] = (Real) vars[i];
+  open  = true;
+}
+
+template<class Real>
+void EventOutput<Real>::fillHadron(Long64_t event_index, double PID, const double* vars){
+  if(!open){
+    // Hadrons before any electron : the event gets the electron kinematics of the hadron rows, and no vertex
+    const int el_vars[kNvarsElectron - 1] = {0, 1, 2, 3, 4, 16, 17, 18, 19, 20, 21};
+    event = event_index;
+    for(int i = 0 ; i < kNvarsElectron - 1 ; i++) vars_el[i] = (Real) vars[el_vars[i]];
+    vars_el[kNvarsElectron - 1] = 0;
+    open  = true;
+  }
+
+  reserve(n_hadrons + 1);
+  pids[n_hadrons] = (Int_t) PID;
+  for(int i = 0 ; i < kNvarsEventHadron ; i++) vars_h[i][n_hadrons] = (Real) vars[kEventHadronVars[i]];
+  n_hadrons++;
+}
+
+template<class Real>
+void EventOutput<Real>::flush(){
+  if(open) fillEvent();
+}
+
+template<class Real>
+void EventOutput<Real>::write(){
+  flush();
+  events->Write();
+  if(raw) raw->Write();
+}
+
+#endif
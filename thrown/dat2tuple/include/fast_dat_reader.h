@@ -0,0 +1,105 @@
+// Fast reader of the .dat format written by lepto2dat.pl (--reader=fast)
+// The file is mapped in memory and the numbers are parsed in place with std::from_chars : no iostreams,
+// no locale and no intermediate tree. from_chars rounds like strtod, so the rows are the same as with DatReader.
+
+// author : Esteban Molina
+
+#ifndef FAST_DAT_READER_H
+#define FAST_DAT_READER_H
+
+#include "lepto_parser.h"
+
+#include <charconv>
+#include <cstddef>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class FastDatReader{
+  int         fd;
+  size_t      size;
+  const char* data;
+  const char* pos;
+  const char* end;
+  long        n_rows;
+
+  void skipSpaces();
+  template<class T> bool getNumber(T& value);
+
+public:
+  // Maps the file
+  FastDatReader(const char* file_name);
+  // Reads rows from a buffer already in memory (not copied, it has to outlive the reader)
+  FastDatReader(const char* buffer, size_t buffer_size);
+  ~FastDatReader();
+
+  bool isOpen()		{return data != nullptr;}
+
+  // Reads the next row : <event_index> <particle_id> <parent_id> <px> <py> <pz> <E> <x> <y> <z>
+  // Returns false at the end of the input or at the first row that can not be read
+  bool nextRow(ThrownParticle& p);
+
+  long getNrows()	{return n_rows;}
+};
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+FastDatReader::FastDatReader(const char* file_name) : fd(-1), size(0), data(nullptr), pos(nullptr), end(nullptr), n_rows(0){
+  // Class constructor
+  fd = open(file_name, O_RDONLY);
+  if(fd < 0) return;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0) return;
+  size = st.st_size;
+  if(size == 0){
+    // mmap does not take empty files
+    data = pos = end = "";
+    return;
+  }
+
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(map == MAP_FAILED) return;
+  madvise(map, size, MADV_SEQUENTIAL);
+  data = pos = (const char*) map;
+  end  = data + size;
+}
+
+FastDatReader::FastDatReader(const char* buffer, size_t buffer_size) :
+  fd(-1), size(0), data(buffer), pos(buffer), end(buffer + buffer_size), n_rows(0){}
+
+FastDatReader::~FastDatReader(){
+  if(fd >= 0 && size > 0 && data) munmap((void*) data, size);
+  if(fd >= 0) close(fd);
+}
+
+void FastDatReader::skipSpaces(){
+  while(pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\t' || *pos == '\r')) pos++;
+}
+
+template<class T>
+bool FastDatReader::getNumber(T& value){
+  skipSpaces();
+  std::from_chars_result result = std::from_chars(pos, end, value);
+  if(result.ec != std::errc()) return false;
+  pos = result.ptr;
+  return true;
+}
+
+bool FastDatReader::nextRow(ThrownParticle& p){
+  if(!data) return false;
+  if(!(getNumber(p.event_index) && getNumber(p.PID) && getNumber(p.parent_PID) &&
+       getNumber(p.Px) && getNumber(p.Py) && getNumber(p.Pz) && getNumber(p.E) &&
+       getNumber(p.x) && getNumber(p.y) && getNumber(p.z))) return false;
+  n_rows++;
+  return true;
+}
+
+#endif
@@ -0,0 +1,71 @@
+// Fused, allocation-free hadron-frame kinematics
+// The virtual photon frame is built once per event from the scattered electron, and every
+// hadron-frame variable is obtained from a single evaluation with closed forms : no TVector3,
+// no rotations, and |p_h| and the dot products computed only once per hadron.
+// HadronicKinematics stays as the reference, see src/check_kinematics.cpp for the comparison.
+// VirtualPhotonFrame is in kinematics.h with the reference classes, FusedFiller fills the ntuples with it.
+
+// author : Esteban Molina
+
+#ifndef HADRON_FRAME_H
+#define HADRON_FRAME_H
+
+#include "dat2tuple.h"
+
+#include <cmath>
+
+//####################################################################################################################//
+//########################################        NTUPLE FILLING         #############################################//
+//####################################################################################################################//
+
+// Version of fillThrown that builds the electron kinematics and the virtual photon frame once per event
+
+template<class Run>
+class FusedFiller{
+  ThrownOutput*           output;
+  const Run&              run;
+  Long64_t                event;
+  LeptonicKinematics<Run> lk;
+  VirtualPhotonFrame<Run> frame;
+
+public:
+  FusedFiller(ThrownOutput* output, const Run& run);
+  ~FusedFiller();
+
+  void fill(double PID, double parent_PID, double Px, double Py, double Pz, double z);
+  // Numbers an event that is not filled (rejected by the selection)
+  void skipEvent()	{event++;}
+};
+
+template<class Run>
+FusedFiller<Run>::FusedFiller(ThrownOutput* out, const Run& r) :
+  output(out), run(r), event(out->getFirstEvent() - 1), lk(0., 0., 0., r), frame(lk){}
+
+template<class Run>
+FusedFiller<Run>::~FusedFiller(){}
+
+template<class Run>
+void FusedFiller<Run>::fill(double PID, double parent_PID, double Px, double Py, double Pz, double z){
+  // Same selection as fillThrown
+  if(PID==11 && parent_PID==0){
+    lk    = LeptonicKinematics<Run>(Px,Py,Pz,run);
+    frame = VirtualPhotonFrame<Run>(lk);
+    event++;
+
+    double vars_el[kNvarsElectron] = {lk.getQ2(), lk.getXb(), lk.getNu(), lk.getW(), lk.gety(), lk.getThetaLab_el(), lk.getPhiLab_el(), lk.getP_el(), Px, Py, Pz, z};
+    output->fillElectron(event, vars_el);
+  }
+  else if(PID != 11 && PID != 22 && PID !=-11){
+    HadronFrameVars h;
+    frame.compute(Px, Py, Pz, HadronicKinematics<Run>::getMass_h(PID), h);
+
+    double vars_h[kNvarsHadron] = {lk.getQ2(), lk.getXb(), lk.getNu(), lk.getW(), lk.gety(), h.Zh, h.Pt2,
+				   h.Pl2, h.ThetaPQ, h.PhiPQ, h.ThetaLab_h,
+				   h.PhiLab_h, h.P_h, Px, Py, Pz,
+				   lk.getThetaLab_el(), lk.getPhiLab_el(), lk.getP_el(), lk.getPx_el(), lk.getPy_el(), lk.getPz_el()};
+
+    output->fillHadron(event, PID, vars_h);
+  }
+}
+
+#endif
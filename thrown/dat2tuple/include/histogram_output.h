@@ -0,0 +1,307 @@
+// Sparse histograms of the thrown kinematics filled while converting (--histograms=<config>)
+// The multiplicity ratio denominators are filled in the same pass as the conversion, and with --no_ntuples
+// without writing the ntuples at all. Each line of the config file books one THnSparseD :
+//   <name> <particles> <axis> [<axis> ...]
+//     particles : electron, hadrons (every hadron) or PIDs separated by commas (211,-211)
+//     axis      : <variable>:<n_bins>:<min>:<max>  uniform bins
+//                 <variable>:<edge>,<edge>,...     variable bins
+//     variables : the typed branch names (kHadronBranches or kElectronBranches of thrown_output.h)
+//   # Example
+//   electrons electron Q2:1,1.5,2,2.5,3,4,6 Nu:2.2,3.2,3.7,4.2
+//   pip       211      Q2:1,1.5,2,2.5,3,4,6 Nu:2.2,3.2,3.7,4.2 Zh:10:0:1 Pt2:10:0:1 PhiPQ:12:-180:180
+// Lines starting with # are comments. The histograms are written to the output file with their names.
+// Every worker thread fills its own HistogramSet, the sets are added when the threads are done.
+
+// author : Esteban Molina
+
+#ifndef HISTOGRAM_OUTPUT_H
+#define HISTOGRAM_OUTPUT_H
+
+#include "thrown_output.h"
+#include "job_report.h"
+#include "THnSparse.h"
+#include "TAxis.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//####################################################################################################################//
+//########################################        DATA RECORDS           #############################################//
+//####################################################################################################################//
+
+struct HistogramAxis{
+  std::string         var;
+  int                 index;	// position in the hadron or electron columns
+  int                 n_bins;
+  double              min, max;
+  std::vector<double> edges;	// variable bins, empty for uniform bins
+};
+
+struct HistogramConfig{
+  std::string                name;
+  bool                       electron;	// filled with the scattered electrons instead of the hadrons
+  bool                       all_hadrons;
+  std::vector<int>           pids;
+  std::vector<HistogramAxis> axes;
+};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class HistogramSet{
+  std::vector<HistogramConfig> configs;
+  std::vector<THnSparseD*>     histograms;
+  std::vector<double>          point;
+
+public:
+  // Books one histogram per config, outside of any directory
+  HistogramSet(const std::vector<HistogramConfig>& configs);
+  ~HistogramSet();
+
+  void fillHadron(double PID, const double* vars);
+  void fillElectron(const double* vars);
+
+  // Adds the histograms of another set with the same configs (reduction of the worker threads)
+  void add(const HistogramSet& other);
+  // Writes the histograms in the current directory
+  void write();
+};
+
+// Fills a HistogramSet with the rows of the fillers and passes them to the ntuple output, if any
+class HistogramOutput : public ThrownOutput{
+  HistogramSet& histograms;
+  ThrownOutput* ntuples;	// owned, 0 with --no_ntuples
+
+public:
+  HistogramOutput(HistogramSet& histograms, ThrownOutput* ntuples);
+  ~HistogramOutput();
+
+  void setReport(JobReport* r);
+
+  void fillHadron(Long64_t event, double PID, const double* vars);
+  void fillElectron(Long64_t event, const double* vars);
+  void fillRaw(Long64_t event_index, double PID, double parent_PID, const double* vars);
+
+  // Writes the ntuples. The histograms are written by their owner, once the set is complete
+  void flush();
+  void write();
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+int getColumnIndex(const std::string& var, bool electron){
+  // Position of a typed branch name in the electron or hadron columns, -1 if unknown
+  int                n_vars = electron ? kNvarsElectron : kNvarsHadron;
+  const char* const* names  = electron ? kElectronBranches : kHadronBranches;
+  for(int i = 0 ; i < n_vars ; i++){
+    if(var == names[i]) return i;
+  }
+  return -1;
+}
+
+bool parseHistogramAxis(const std::string& text, bool electron, HistogramAxis& axis){
+  // <variable>:<n_bins>:<min>:<max> or <variable>:<edge>,<edge>,...
+  size_t colon = text.find(':');
+  if(colon == std::string::npos) return false;
+  axis.var   = text.substr(0, colon);
+  axis.index = getColumnIndex(axis.var, electron);
+  if(axis.index < 0) return false;
+
+  std::string bins = text.substr(colon + 1);
+  if(bins.find(',') != std::string::npos){
+    std::istringstream in(bins);
+    std::string edge;
+    while(std::getline(in, edge, ',')){
+      char* end = 0;
+      double value = std::strtod(edge.c_str(), &end);
+      if(edge.empty() || *end != '\0' || (!axis.edges.empty() && value <= axis.edges.back())) return false;
+      axis.edges.push_back(value);
+    }
+    if(axis.edges.size() < 2) return false;
+    axis.n_bins = axis.edges.size() - 1;
+    axis.min    = axis.edges.front();
+    axis.max    = axis.edges.back();
+    return true;
+  }
+
+  for(char& c : bins) if(c == ':') c = ' ';
+  std::istringstream in(bins);
+  std::string rest;
+  if(!(in >> axis.n_bins >> axis.min >> axis.max) || (in >> rest)) return false;
+  return axis.n_bins > 0 && axis.max > axis.min;
+}
+
+bool readHistogramConfig(const std::string& file_name, std::vector<HistogramConfig>& configs){
+  // Returns false, after printing the wrong line, if the file can not be read or parsed
+  std::ifstream file(file_name);
+  if(!file.is_open()){
+    std::cout<<"Could not open "<<file_name<<std::endl;
+    return false;
+  }
+
+  std::string line;
+  int n_line = 0;
+  while(std::getline(file, line)){
+    n_line++;
+    std::istringstream in(line);
+    HistogramConfig config;
+    std::string particles, axis_text;
+    if(!(in >> config.name) || config.name[0] == '#') continue;
+
+    bool ok = (bool) (in >> particles);
+    config.electron    = (particles == "electron");
+    config.all_hadrons = (particles == "hadrons");
+    if(ok && !config.electron && !config.all_hadrons){
+      std::istringstream pids(particles);
+      std::string pid;
+      while(ok && std::getline(pids, pid, ',')){
+	char* end = 0;
+	long value = std::strtol(pid.c_str(), &end, 10);
+	ok = !pid.empty() && *end == '\0';
+	config.pids.push_back((int) value);
+      }
+    }
+    while(ok && in >> axis_text){
+      HistogramAxis axis;
+      ok = parseHistogramAxis(axis_text, config.electron, axis);
+      config.axes.push_back(axis);
+    }
+    for(const HistogramConfig& other : configs) ok = ok && other.name != config.name;
+
+    if(!ok || config.axes.empty()){
+      std::cout<<"Wrong histogram definition in "<<file_name<<":"<<n_line<<" : "<<line<<std::endl;
+      return false;
+    }
+    configs.push_back(config);
+  }
+
+  if(configs.empty()){
+    std::cout<<"No histograms defined in "<<file_name<<std::endl;
+    return false;
+  }
+  return true;
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+HistogramSet::HistogramSet(const std::vector<HistogramConfig>& c) : configs(c){
+  // Class constructor
+  size_t max_dim = 0;
+  for(const HistogramConfig& config : configs){
+    int dim = config.axes.size();
+    std::vector<int>    n_bins(dim);
+    std::vector<double> min(dim), max(dim);
+    std::string title;
+    for(int i = 0 ; i < dim ; i++){
+      n_bins[i] = config.axes[i].n_bins;
+      min[i]    = config.axes[i].min;
+      max[i]    = config.axes[i].max;
+      title    += (i ? ":" : "") + config.axes[i].var;
+    }
+
+    THnSparseD* h = new THnSparseD(config.name.c_str(), title.c_str(), dim, n_bins.data(), min.data(), max.data());
+    for(int i = 0 ; i < dim ; i++){
+      h->GetAxis(i)->SetName(config.axes[i].var.c_str());
+      h->GetAxis(i)->SetTitle(config.axes[i].var.c_str());
+      if(!config.axes[i].edges.empty()) h->GetAxis(i)->Set(n_bins[i], config.axes[i].edges.data());
+    }
+    histograms.push_back(h);
+    if((size_t) dim > max_dim) max_dim = dim;
+  }
+  point.resize(max_dim);
+}
+
+HistogramSet::~HistogramSet(){
+  for(THnSparseD* h : histograms) delete h;
+}
+
+void HistogramSet::fillHadron(double PID, const double* vars){
+  int pid = (int) PID;
+  for(size_t i = 0 ; i < configs.size() ; i++){
+    const HistogramConfig& config = configs[i];
+    if(config.electron) continue;
+    bool selected = config.all_hadrons;
+    for(size_t j = 0 ; !selected && j < config.pids.size() ; j++) selected = (config.pids[j] == pid);
+    if(!selected) continue;
+
+    for(size_t j = 0 ; j < config.axes.size() ; j++) point[j] = vars[config.axes[j].index];
+    histograms[i]->Fill(point.data());
+  }
+}
+
+void HistogramSet::fillElectron(const double* vars){
+  for(size_t i = 0 ; i < configs.size() ; i++){
+    if(!configs[i].electron) continue;
+    for(size_t j = 0 ; j < configs[i].axes.size() ; j++) point[j] = vars[configs[i].axes[j].index];
+    histograms[i]->Fill(point.data());
+  }
+}
+
+void HistogramSet::add(const HistogramSet& other){
+  for(size_t i = 0 ; i < histograms.size() ; i++) histograms[i]->Add(other.histograms[i]);
+}
+
+void HistogramSet::write(){
+  for(THnSparseD* h : histograms) h->Write();
+}
+
+HistogramOutput::HistogramOutput(HistogramSet& h, ThrownOutput* n) : ThrownOutput(false, false), histograms(h), ntuples(n){
+  // Class constructor
+  // The trees of the ntuple output, so the conversion handles them as without histograms
+  if(ntuples){
+    hadrons     = ntuples->getHadronTree();
+    electrons   = ntuples->getElectronTree();
+    raw         = ntuples->getRawTree();
+    events      = ntuples->getEventTree();
+    with_raw    = ntuples->hasRaw();
+    first_event = ntuples->getFirstEvent();
+  }
+}
+
+HistogramOutput::~HistogramOutput(){
+  delete ntuples;
+}
+
+void HistogramOutput::setReport(JobReport* r){
+  report = r;
+  if(ntuples) ntuples->setReport(r);
+}
+
+void HistogramOutput::fillHadron(Long64_t event, double PID, const double* vars){
+  {
+    FillTimer timer(report, 0);
+    histograms.fillHadron(PID, vars);
+  }
+  if(ntuples) ntuples->fillHadron(event, PID, vars);
+}
+
+void HistogramOutput::fillElectron(Long64_t event, const double* vars){
+  {
+    FillTimer timer(report, 0);
+    histograms.fillElectron(vars);
+  }
+  if(ntuples) ntuples->fillElectron(event, vars);
+}
+
+void HistogramOutput::fillRaw(Long64_t event_index, double PID, double parent_PID, const double* vars){
+  if(ntuples) ntuples->fillRaw(event_index, PID, parent_PID, vars);
+}
+
+void HistogramOutput::flush(){
+  if(ntuples) ntuples->flush();
+}
+
+void HistogramOutput::write(){
+  if(ntuples) ntuples->write();
+}
+
+#endif
@@ -0,0 +1,264 @@
+// Per-stage timers and counters of a dat2tuple job, written as a JSON report next to the output (--report)
+// Stages (seconds, summed over the worker threads when converting in parallel) :
+//   read       : reading and parsing the input (TTree::ReadFile, DatReader, FastDatReader, LeptoParser or the binary map)
+//   kinematics : leptonic and hadronic variables, i.e. the time of the fillers minus the output fills
+//   fill       : filling the output columns
+//   compress   : fills that flushed baskets to the file (compression and writing of the full baskets). Trees kept in
+//                memory (no --stream) are compressed when they are written, that time also goes here
+//   write      : writing the trees, closing the output and the LUND/binary files
+// Counters : events (scattered electrons), rows by PID, hadrons filled, rows skipped by the fillers (photons,
+// positrons and electrons other than the scattered one), events and hadrons rejected by --select, bytes in/out and peak RSS.
+
+// author : Esteban Molina
+
+#ifndef JOB_REPORT_H
+#define JOB_REPORT_H
+
+#include "monitoring.h"
+#include "options.h"
+#include "TTree.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/stat.h>
+
+enum ReportStage{kStageRead, kStageKinematics, kStageFill, kStageCompress, kStageWrite, kNstages};
+
+const char* const kStageNames[kNstages] = {"read", "kinematics", "fill", "compress", "write"};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class JobReport{
+  std::chrono::steady_clock::time_point start;
+  std::mutex                            mutex;
+  double                                seconds[kNstages];	// kinematics includes the output fills, see getSeconds
+  double                                fill_seconds;		// output fills done by the fillers (fill and compress)
+  Long64_t                              n_events, n_hadrons, n_rows;
+  Long64_t                              n_photons, n_positrons, n_electrons;	// skipped rows
+  Long64_t                              n_rejected_events, n_rejected_hadrons;	// selection (selection.h)
+  std::unordered_map<int, Long64_t>     rows_by_pid;
+  double                                bytes_in;
+
+public:
+  JobReport();
+  ~JobReport();
+
+  void addTime(ReportStage stage, double s)	{seconds[stage] += s;}
+  void addFillTime(ReportStage stage, double s)	{seconds[stage] += s; fill_seconds += s;}
+  void addBytesIn(double bytes)			{bytes_in += bytes;}
+
+  // Counts one row given to the fillers
+  void countRow(int PID, int parent_PID);
+  // Counts one event or hadron rejected by the selection
+  void countRejected(bool event)	{if(event) n_rejected_events++; else n_rejected_hadrons++;}
+
+  // Adds the timers and counters of a worker thread
+  void merge(const JobReport& other);
+
+  double   getSeconds(ReportStage stage);
+  Long64_t getNevents()		{return n_events;}
+
+  // Writes the report of the job described by opt. Returns false if the file can not be written
+  bool writeJson(const std::string& file_name, const Options& opt, int status);
+};
+
+// Adds the time between its creation and stop() (or its destruction) to a stage, does nothing without a report
+class StageTimer{
+  JobReport*                            report;
+  ReportStage                           stage;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  StageTimer(JobReport* r, ReportStage s);
+  ~StageTimer();
+
+  void stop();
+};
+
+// Times one fill of the output : compress if the tree wrote baskets during the fill, fill otherwise
+class FillTimer{
+  JobReport*                            report;
+  TTree*                                tree;
+  Long64_t                              zip_bytes;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  FillTimer(JobReport* r, TTree* t);
+  ~FillTimer();
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+double getElapsed(const std::chrono::steady_clock::time_point& start){
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double getFileBytes(const std::string& file_name){
+  // Size of a file in bytes, 0 if it does not exist
+  struct stat st;
+  if(file_name.empty() || stat(file_name.c_str(), &st) != 0) return 0.;
+  return st.st_size;
+}
+
+std::string getReportName(const Options& opt){
+  // --report value, or the output name with .report.json instead of .root
+  if(!opt.report.empty()) return opt.report;
+  std::string name = opt.file_out;
+  if(name.size() > 5 && name.compare(name.size() - 5, 5, ".root") == 0) name.erase(name.size() - 5);
+  return name + ".report.json";
+}
+
+std::string toJsonString(const std::string& s){
+  // Quoted JSON string
+  std::string out = "\"";
+  for(char c : s){
+    if(c == '"' || c == '\\') out += '\\';
+    if((unsigned char) c < 0x20){
+      char code[8];
+      std::snprintf(code, sizeof(code), "\\u%04x", c);
+      out += code;
+    }
+    else out += c;
+  }
+  return out + "\"";
+}
+
+std::string getEnvironment(const char* name){
+  const char* value = std::getenv(name);
+  return value ? value : "";
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+JobReport::JobReport() : start(std::chrono::steady_clock::now()), fill_seconds(0.), n_events(0), n_hadrons(0), n_rows(0),
+			 n_photons(0), n_positrons(0), n_electrons(0), n_rejected_events(0), n_rejected_hadrons(0), bytes_in(0.){
+  // Class constructor
+  for(int i = 0 ; i < kNstages ; i++) seconds[i] = 0.;
+}
+
+JobReport::~JobReport(){}
+
+void JobReport::countRow(int PID, int parent_PID){
+  // Same selection as fillThrown
+  n_rows++;
+  rows_by_pid[PID]++;
+  if(PID==11 && parent_PID==0) n_events++;
+  else if(PID == 11)           n_electrons++;
+  else if(PID == 22)           n_photons++;
+  else if(PID == -11)          n_positrons++;
+  else                         n_hadrons++;
+}
+
+void JobReport::merge(const JobReport& other){
+  std::lock_guard<std::mutex> lock(mutex);
+  for(int i = 0 ; i < kNstages ; i++) seconds[i] += other.seconds[i];
+  fill_seconds       += other.fill_seconds;
+  n_events           += other.n_events;
+  n_hadrons          += other.n_hadrons;
+  n_rows             += other.n_rows;
+  n_photons          += other.n_photons;
+  n_positrons        += other.n_positrons;
+  n_electrons        += other.n_electrons;
+  n_rejected_events  += other.n_rejected_events;
+  n_rejected_hadrons += other.n_rejected_hadrons;
+  bytes_in           += other.bytes_in;
+  for(const auto& pid : other.rows_by_pid) rows_by_pid[pid.first] += pid.second;
+}
+
+double JobReport::getSeconds(ReportStage stage){
+  if(stage != kStageKinematics) return seconds[stage];
+  // The fillers time the kinematics together with the output fills
+  double s = seconds[kStageKinematics] - fill_seconds;
+  return (s > 0.) ? s : 0.;
+}
+
+bool JobReport::writeJson(const std::string& file_name, const Options& opt, int status){
+  FILE* out = std::fopen(file_name.c_str(), "w");
+  if(!out) return false;
+
+  double bytes_out = getFileBytes(opt.file_out) + getFileBytes(opt.lund_out) + getFileBytes(opt.binary_out);
+  for(int k = 0 ; opt.shards > 1 && k < opt.shards ; k++){
+    bytes_out += getFileBytes(getShardName(opt.file_out, k)) + getFileBytes(getShardName(opt.lund_out, k));
+  }
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+
+  std::fprintf(out, "{\n");
+  std::fprintf(out, "  \"report_version\": 1,\n");
+  std::fprintf(out, "  \"status\": %d,\n", status);
+  std::fprintf(out, "  \"host\": %s,\n", toJsonString(host).c_str());
+  std::fprintf(out, "  \"slurm_job_id\": %s,\n", toJsonString(getEnvironment("SLURM_JOB_ID")).c_str());
+  std::fprintf(out, "  \"slurm_array_task_id\": %s,\n", toJsonString(getEnvironment("SLURM_ARRAY_TASK_ID")).c_str());
+  std::fprintf(out, "  \"input\": %s,\n", toJsonString(opt.file_in).c_str());
+  std::fprintf(out, "  \"output\": %s,\n", toJsonString(opt.file_out).c_str());
+  std::fprintf(out, "  \"options\": {\"input\": %s, \"reader\": %s, \"kinematics\": %s, \"threads\": %d, \"stream\": %s, \"merge\": %s, "
+	       "\"backend\": %s, \"schema\": %s, \"precision\": %s, \"compression\": %s, \"beam_energy\": %g, \"target_mass\": %g, \"select\": %s},\n",
+	       toJsonString(opt.input).c_str(), toJsonString(opt.reader).c_str(), toJsonString(opt.kinematics).c_str(), opt.threads,
+	       opt.stream ? "true" : "false", opt.merge ? "true" : "false", toJsonString(opt.backend).c_str(), toJsonString(opt.schema).c_str(),
+	       toJsonString(opt.precision).c_str(), toJsonString(opt.compression).c_str(), opt.beam_energy, opt.target_mass, toJsonString(opt.select).c_str());
+  std::fprintf(out, "  \"wall_seconds\": %.6f,\n", getElapsed(start));
+  std::fprintf(out, "  \"stage_seconds\": {");
+  for(int i = 0 ; i < kNstages ; i++) std::fprintf(out, "%s\"%s\": %.6f", i ? ", " : "", kStageNames[i], getSeconds((ReportStage) i));
+  std::fprintf(out, "},\n");
+  std::fprintf(out, "  \"events\": %lld,\n", (long long) n_events);
+  std::fprintf(out, "  \"rows\": %lld,\n", (long long) n_rows);
+  std::fprintf(out, "  \"hadrons\": %lld,\n", (long long) n_hadrons);
+  std::fprintf(out, "  \"skipped_rows\": {\"photons\": %lld, \"positrons\": %lld, \"electrons\": %lld},\n",
+	       (long long) n_photons, (long long) n_positrons, (long long) n_electrons);
+  std::fprintf(out, "  \"rejected\": {\"events\": %lld, \"hadrons\": %lld},\n", (long long) n_rejected_events, (long long) n_rejected_hadrons);
+  // Sorted by PID so reports can be compared line by line
+  std::map<int, Long64_t> sorted(rows_by_pid.begin(), rows_by_pid.end());
+  std::fprintf(out, "  \"rows_by_pid\": {");
+  bool first = true;
+  for(const auto& pid : sorted){
+    std::fprintf(out, "%s\"%d\": %lld", first ? "" : ", ", pid.first, (long long) pid.second);
+    first = false;
+  }
+  std::fprintf(out, "},\n");
+  std::fprintf(out, "  \"bytes_in\": %.0f,\n", bytes_in);
+  std::fprintf(out, "  \"bytes_out\": %.0f,\n", bytes_out);
+  std::fprintf(out, "  \"peak_rss_mb\": %.1f\n", getPeakRSS());
+  std::fprintf(out, "}\n");
+
+  return std::fclose(out) == 0;
+}
+
+StageTimer::StageTimer(JobReport* r, ReportStage s) : report(r), stage(s){
+  if(report) start = std::chrono::steady_clock::now();
+}
+
+StageTimer::~StageTimer(){
+  stop();
+}
+
+void StageTimer::stop(){
+  if(!report) return;
+  report->addTime(stage, getElapsed(start));
+  report = 0;
+}
+
+FillTimer::FillTimer(JobReport* r, TTree* t) : report(r), tree(t), zip_bytes(0){
+  if(!report) return;
+  if(tree) zip_bytes = tree->GetZipBytes();
+  start = std::chrono::steady_clock::now();
+}
+
+FillTimer::~FillTimer(){
+  if(!report) return;
+  double s = getElapsed(start);
+  report->addFillTime((tree && tree->GetZipBytes() != zip_bytes) ? kStageCompress : kStageFill, s);
+}
+
+#endif
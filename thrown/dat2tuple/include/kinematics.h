@@ -0,0 +1,321 @@
+// Kinematics of the scattered electron and of the hadrons, shared by dat2tuple, check_kinematics and the RDataFrame
+// functors of libThrownKinematics.so (kinematics_functors.h). Needs ROOT's TVector3 and TMath only.
+//   LeptonicKinematics, HadronicKinematics : per-particle reference classes
+//   VirtualPhotonFrame                     : fused hadron-frame kinematics, once per event (see hadron_frame.h)
+
+// author : Esteban Molina
+
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include "TVector3.h"
+#include "TMath.h"
+#include "constants.h"
+#include "run_constants.h"
+
+#include <cmath>
+#include <iostream>
+
+//####################################################################################################################//
+//########################################         DATA RECORDS          #############################################//
+//####################################################################################################################//
+
+struct HadronFrameVars{
+  double P_h, ThetaLab_h, PhiLab_h;			// lab frame
+  double Zh, CosThetaPQ, Pt2, Pl2, ThetaPQ, PhiPQ;	// virtual photon frame
+};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+// Both classes are templated on the run constants : RunConstants (values set at run time) or
+// FixedRunConstants<E> (beam energy known at compile time)
+
+// LEPTONIC CLASS
+
+template<class Run = RunConstants>
+class LeptonicKinematics{
+  double Ebeam, Q2, Xb, Nu, W, y, Px_el, Py_el, Pz_el, P_el, ThetaLab_el, PhiLab_el;
+
+public:
+  LeptonicKinematics(double, double, double, const Run& run = Run());
+  ~LeptonicKinematics();
+
+  double getEbeam()		{return Ebeam;}
+
+  //protected:
+  double getQ2()	        {return Q2;}
+  double getXb()	        {return Xb;}
+  double getNu()		{return Nu;}
+  double getW()		        {return W;}
+  double gety()		        {return y;}
+  double getP_el()		{return P_el;}
+  double getThetaLab_el()	{return ThetaLab_el;}
+  double getPhiLab_el()      	{return PhiLab_el;}
+  double getPx_el()		{return Px_el;}
+  double getPy_el()		{return Py_el;}
+  double getPz_el()		{return Pz_el;}  
+};
+
+// HADRONIC CLASS
+
+template<class Run = RunConstants>
+class HadronicKinematics{
+  double Px_h, Py_h, Pz_h, P_h, ThetaLab_h, PhiLab_h, PID_h;
+
+public:
+  friend class LeptonicKinematics<Run>;
+  
+  HadronicKinematics(double, double, double, double);
+  ~HadronicKinematics();
+
+  static double getMass_h(double);
+  
+  double getThetaLab_h()	        {return ThetaLab_h;}
+  double getPhiLab_h()	        {return PhiLab_h;}
+  double getP_h()		{return P_h;}
+  double getPx_h()		{return Px_h;}
+  double getPy_h()		{return Py_h;}
+  double getPz_h()		{return Pz_h;}
+
+  double getThetaPQ(LeptonicKinematics<Run>* lk);
+  double getPhiPQ(LeptonicKinematics<Run>* lk);
+  double getCosThetaPQ(LeptonicKinematics<Run>* lk);
+  double getZh(LeptonicKinematics<Run>* lk);
+  double getPl2(LeptonicKinematics<Run>* lk);
+  double getPt2(LeptonicKinematics<Run>* lk);
+};
+
+// VIRTUAL PHOTON FRAME
+// Built once per event from the scattered electron. Every hadron-frame variable is obtained with closed forms :
+// no TVector3, no rotations, and |p_h| and the dot products computed only once per hadron
+
+template<class Run = RunConstants>
+class VirtualPhotonFrame{
+  double Nu, Qx, Qy, Qz, Qt2, Q_mag, Pq_mag;
+
+public:
+  VirtualPhotonFrame();
+  VirtualPhotonFrame(LeptonicKinematics<Run>& lk);
+  ~VirtualPhotonFrame();
+
+  double getNu()	{return Nu;}
+  double getQ_mag()	{return Q_mag;}
+
+  void compute(double Px, double Py, double Pz, double mass, HadronFrameVars& out) const;
+};
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+// Leptonic class
+
+template<class Run>
+LeptonicKinematics<Run>::LeptonicKinematics(double Px, double Py, double Pz, const Run& run){
+  // Class constructor
+  TVector3 v(Px, Py, Pz);
+  Ebeam         = run.getEbeam();
+
+  // momentum
+  P_el		= TMath::Sqrt(Px*Px + Py*Py + Pz*Pz);
+  Px_el		= Px;
+  Py_el		= Py;
+  Pz_el		= Pz;
+
+  // direction
+  ThetaLab_el	= v.Theta()*TMath::RadToDeg();
+  PhiLab_el	= v.Phi()*TMath::RadToDeg();
+
+  // leptonic
+  Q2		= 4.*Ebeam*P_el*TMath::Sin(v.Theta()/2.)*TMath::Sin(v.Theta()/2.);
+  Nu		= Ebeam - P_el;
+  Xb		= Q2/2./run.getMtarget()/Nu;
+  W             = TMath::Sqrt(run.getMtarget2() + run.get2Mtarget()*Nu - Q2);
+  y             = Nu/Ebeam;
+}
+
+template<class Run>
+LeptonicKinematics<Run>::~LeptonicKinematics(){}
+
+// Hadronic class
+
+template<class Run>
+HadronicKinematics<Run>::HadronicKinematics(double Px, double Py, double Pz, double PID){
+  // Class constructor
+  TVector3 v(Px, Py, Pz);
+  PID_h = PID;
+  
+  // momentum
+  //  P_h		= v.Mag();
+  P_h           = TMath::Sqrt(Px*Px + Py*Py + Pz*Pz);
+  Px_h		= Px;
+  Py_h		= Py;
+  Pz_h		= Pz;
+  // direction
+  ThetaLab_h	= v.Theta()*TMath::RadToDeg();
+  PhiLab_h	= v.Phi()*TMath::RadToDeg();
+}
+
+template<class Run>
+HadronicKinematics<Run>::~HadronicKinematics(){}
+
+template<class Run>
+double HadronicKinematics<Run>::getMass_h(double PID_h){
+  if(PID_h == 211){
+    return kMassPiPlus;
+  } else if(PID_h == -211){
+    return kMassPiMinus;
+  } else if(PID_h == 111){
+    return kMassPiZero;
+  } else if(PID_h == 221){
+    return kMassEta;
+  } else if(PID_h == 223){
+    return kMassOmega;
+  } else if(PID_h == 2212){
+    return kMassProton;
+  } else if(PID_h == 2112){
+    return kMassNeutron;
+  } else if(PID_h == 311){
+    return kMassKaonZero;
+  } else if(PID_h == 321){
+    return kMassKaonPlus;    
+  } else if(PID_h == -321){
+    return kMassKaonMinus;    
+  } else if(PID_h == 22){
+    return kMassGamma;
+  } else{
+    return 0;
+  }
+}
+
+template<class Run>
+double HadronicKinematics<Run>::getPhiPQ(LeptonicKinematics<Run>* lk) {
+  // Returns the azimuthal angle of the particle w.r.t. the virtual photon direction
+  // First, it Z-rotates the virtual photon momentum to have Y-component=0
+  // Second, it Z-rotates the particle momentum by the same amount
+  // Third, it Y-rotates the virtual photon to have X-component=0
+  // Lastly, it Y-rotates the particle momentum by the same amount
+  // In the end, the values of the particle momentum components will be w.r.t to the virtual photon momentum
+  TVector3 Vpi(this->Px_h, this->Py_h, this->Pz_h);
+  TVector3 Vvirt(-lk->getPx_el(), -lk->getPy_el(), lk->getEbeam() - lk->getPz_el());
+  Double_t phi_z = TMath::Pi() - Vvirt.Phi();
+  Vvirt.RotateZ(phi_z);
+  Vpi.RotateZ(phi_z);
+  TVector3 Vhelp(0., 0., 1.);
+  Double_t phi_y = Vvirt.Angle(Vhelp);
+  Vvirt.RotateY(phi_y);
+  Vpi.RotateY(phi_y);
+  return Vpi.Phi()*TMath::RadToDeg();
+}
+
+template<class Run>
+double HadronicKinematics<Run>::getThetaPQ(LeptonicKinematics<Run>* lk) {
+  // Return the polar angle of the particle w.r.t. the virtual photon direction
+  // It's defined as the angle between both particle's momentum
+  TVector3 Vpi(this->Px_h, this->Py_h, this->Pz_h);
+  TVector3 Vvirt(-lk->getPx_el(), -lk->getPy_el(), lk->getEbeam() - lk->getPz_el());
+  return Vvirt.Angle(Vpi)*TMath::RadToDeg();
+}
+
+template<class Run>
+double HadronicKinematics<Run>::getCosThetaPQ(LeptonicKinematics<Run>* lk) {
+  // Returns the cosine of ThetaPQ for the particle
+  double Px_h = this->Px_h;
+  double Py_h = this->Py_h;
+  double Pz_h = this->Pz_h;
+  //double Ph_mag = this->getP_h();
+  double Ph_mag = sqrt(Px_h*Px_h + Py_h*Py_h + Pz_h*Pz_h);
+  
+  double Px_q = - lk->getPx_el();
+  double Py_q = - lk->getPy_el();
+  double Pz_q = (lk->getEbeam() - lk->getPz_el());
+  double Pq_mag = sqrt(lk->getNu()*lk->getNu() + lk->getQ2());
+  
+  double result = (Pz_h*Pz_q + Px_h*Px_q + Py_h*Py_q)/(Pq_mag*Ph_mag);
+
+  if(result > 1){
+    std::cout<<" Numerator   = "<<(this->Pz_h * (lk->getEbeam() - lk->getPz_el()) - this->Px_h * lk->getPx_el() - this->Py_h * lk->getPy_el())<<std::endl;
+    std::cout<<" Denominator = "<<(TMath::Sqrt(lk->getNu()*lk->getNu() + lk->getQ2())*this->getP_h())<<std::endl;;
+  }
+  return result;
+}
+
+template<class Run>
+double HadronicKinematics<Run>::getZh(LeptonicKinematics<Run>* lk) {
+  // Returns the energy fraction of the particle
+  double mass = this->getMass_h(this->PID_h);
+  double P_h  = this->getP_h();
+  double Nu   = lk->getNu();
+
+  return TMath::Sqrt(mass*mass + P_h*P_h)/Nu;
+}
+template<class Run>
+double HadronicKinematics<Run>::getPt2(LeptonicKinematics<Run>* lk) {
+  // Returns the square of the transverse momentum component w.r.t. the virtual photon direction
+  double P_h        = this->getP_h();
+  double CosThetaPQ = this->getCosThetaPQ(lk);
+
+  return P_h*P_h*(1. - TMath::Power(CosThetaPQ,2));
+}
+template<class Run>
+double HadronicKinematics<Run>::getPl2(LeptonicKinematics<Run>* lk) {
+  // Returns the square of the longitudinal momentum component w.r.t. the virtual photon direction
+  double P_h        = this->getP_h();
+  double CosThetaPQ = this->getCosThetaPQ(lk);
+  
+  return P_h*P_h*CosThetaPQ*CosThetaPQ;
+}
+
+// Virtual photon frame
+
+template<class Run>
+VirtualPhotonFrame<Run>::VirtualPhotonFrame() : Nu(0.), Qx(0.), Qy(0.), Qz(0.), Qt2(0.), Q_mag(0.), Pq_mag(0.){}
+
+template<class Run>
+VirtualPhotonFrame<Run>::VirtualPhotonFrame(LeptonicKinematics<Run>& lk){
+  // Class constructor, once per event
+  Nu     = lk.getNu();
+  Qx     = -lk.getPx_el();
+  Qy     = -lk.getPy_el();
+  Qz     = lk.getEbeam() - lk.getPz_el();
+  Qt2    = Qx*Qx + Qy*Qy;
+  Q_mag  = std::sqrt(Qt2 + Qz*Qz);
+  // |q| as used by HadronicKinematics::getCosThetaPQ
+  Pq_mag = std::sqrt(Nu*Nu + lk.getQ2());
+}
+
+template<class Run>
+VirtualPhotonFrame<Run>::~VirtualPhotonFrame(){}
+
+template<class Run>
+void VirtualPhotonFrame<Run>::compute(double Px, double Py, double Pz, double mass, HadronFrameVars& out) const{
+  double Pt2_lab = Px*Px + Py*Py;
+  double P2_h    = Pt2_lab + Pz*Pz;
+  double P_h     = std::sqrt(P2_h);
+
+  double dot_t   = Px*Qx + Py*Qy;
+  double dot     = dot_t + Pz*Qz;
+  // q x p_h
+  double cx      = Qy*Pz - Qz*Py;
+  double cy      = Qz*Px - Qx*Pz;
+  double cz      = Qx*Py - Qy*Px;
+
+  out.P_h        = P_h;
+  out.ThetaLab_h = std::atan2(std::sqrt(Pt2_lab), Pz)*TMath::RadToDeg();
+  out.PhiLab_h   = std::atan2(Py, Px)*TMath::RadToDeg();
+
+  out.Zh         = std::sqrt(mass*mass + P2_h)/Nu;
+  out.CosThetaPQ = dot/(Pq_mag*P_h);
+  out.Pt2        = P2_h*(1. - out.CosThetaPQ*out.CosThetaPQ);
+  out.Pl2        = P2_h*out.CosThetaPQ*out.CosThetaPQ;
+  // angle between q and p_h, atan2 keeps the precision close to 0 and 180 degrees
+  out.ThetaPQ    = std::atan2(std::sqrt(cx*cx + cy*cy + cz*cz), dot)*TMath::RadToDeg();
+  // Same result as the RotateZ/RotateY sequence of HadronicKinematics::getPhiPQ : in the frame where q is
+  // the z axis and the electron lies in the xz plane, y = -(q x p_h)_z/qt and x = (qt^2 pz - qz dot_t)/(qt |q|).
+  // Both are multiplied by qt |q| > 0, which leaves the angle unchanged
+  out.PhiPQ      = std::atan2(-cz*Q_mag, Qt2*Pz - Qz*dot_t)*TMath::RadToDeg();
+}
+
+#endif
@@ -0,0 +1,85 @@
+// Kinematics of dat2tuple as a shared library (make lib -> bin/libThrownKinematics.so), so thrown and reconstructed
+// analyses compute them over the columns of any tree with RDataFrame instead of writing derived ntuples.
+// The functors are made of the classes dat2tuple fills its ntuples with (kinematics.h), compiled once in
+// src/kinematics_functors.cpp : macros no longer need their own copy of the kinematics, which drifts
+// (see deprecated/MACRO_dat2thrown.cpp). Only declarations are here, a macro can include this header with the library loaded.
+// The functors are const and keep nothing between calls, so RDataFrame runs them in all the slots of ROOT::EnableImplicitMT :
+//   R__LOAD_LIBRARY(thrown/dat2tuple/bin/libThrownKinematics.so)
+//   #include "thrown/dat2tuple/include/kinematics_functors.h"
+//   ROOT::EnableImplicitMT();
+//   ROOT::RDataFrame df("REC", "reconstructed.root");
+//   auto d = df.Define("Q2", ElectronVariable<float>("Q2", 10.6), {"px_el", "py_el", "pz_el"})
+//              .Define("Zh", HadronArrayVariable<float, int>("Zh", 10.6), {"px_el", "py_el", "pz_el", "px", "py", "pz", "pid"});
+// Variables (degrees and GeV, as in the ntuples) :
+//   ElectronVariable    : Q2, Xb, Nu, W, y, Theta, Phi, P
+//   HadronVariable      : Q2, Xb, Nu, W, y of its electron and Zh, Pt2, Pl2, CosThetaPQ, ThetaPQ, PhiPQ, Theta, Phi, P
+//   HadronArrayVariable : the HadronVariable of every hadron of an event (RVec columns), the electron frame built once
+// Columns are float or double, pids int or the type of the momenta. An unknown variable gives NaN.
+
+// author : Esteban Molina
+
+#ifndef KINEMATICS_FUNCTORS_H
+#define KINEMATICS_FUNCTORS_H
+
+#include "constants.h"
+#include "ROOT/RVec.hxx"
+
+#include <string>
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+// Leptonic variables from the scattered electron momentum
+template<class T>
+class ElectronVariable{
+  int    variable;
+  double beam_energy, target_mass;
+
+public:
+  ElectronVariable(const std::string& name, double beam_energy = kEbeam, double target_mass = kMassProton);
+  ~ElectronVariable();
+
+  double operator()(T Px_el, T Py_el, T Pz_el) const;
+};
+
+// Variables of one hadron (one row per hadron)
+template<class T, class P = int>
+class HadronVariable{
+  int    variable;
+  double beam_energy, target_mass;
+
+public:
+  HadronVariable(const std::string& name, double beam_energy = kEbeam, double target_mass = kMassProton);
+  ~HadronVariable();
+
+  double operator()(T Px_el, T Py_el, T Pz_el, T Px, T Py, T Pz, P pid) const;
+};
+
+// Variables of all the hadrons of an event (one row per event)
+template<class T, class P = int>
+class HadronArrayVariable{
+  int    variable;
+  double beam_energy, target_mass;
+
+public:
+  HadronArrayVariable(const std::string& name, double beam_energy = kEbeam, double target_mass = kMassProton);
+  ~HadronArrayVariable();
+
+  ROOT::RVec<double> operator()(T Px_el, T Py_el, T Pz_el, const ROOT::RVec<T>& Px, const ROOT::RVec<T>& Py,
+				const ROOT::RVec<T>& Pz, const ROOT::RVec<P>& pid) const;
+};
+
+// Compiled in the library
+extern template class ElectronVariable<float>;
+extern template class ElectronVariable<double>;
+extern template class HadronVariable<float, int>;
+extern template class HadronVariable<float, float>;
+extern template class HadronVariable<double, int>;
+extern template class HadronVariable<double, double>;
+extern template class HadronArrayVariable<float, int>;
+extern template class HadronArrayVariable<float, float>;
+extern template class HadronArrayVariable<double, int>;
+extern template class HadronArrayVariable<double, double>;
+
+#endif
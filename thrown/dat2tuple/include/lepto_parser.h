@@ -0,0 +1,173 @@
+// Native reader of LEPTO's "Event listing" blocks
+// Port of the parsing done in lepto2dat.pl, so dat2tuple can read the raw LEPTO output directly
+// without the intermediate .dat file
+
+// author : Esteban Molina
+
+#ifndef LEPTO_PARSER_H
+#define LEPTO_PARSER_H
+
+#include <istream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+//####################################################################################################################//
+//########################################         DATA RECORDS          #############################################//
+//####################################################################################################################//
+
+// One line of the LEPTO listing : particle[index, KS, pid, orig, energy, p_x, p_y, p_z]
+struct LeptoRecord{
+  int    index, KS, KF, orig;
+  double E, Px, Py, Pz;
+};
+
+// One row of the .dat format : <event_index> <particle_id> <parent_id> <px> <py> <pz> <E> <x> <y> <z>
+struct ThrownParticle{
+  int    event_index, PID, parent_PID;
+  double Px, Py, Pz, E, x, y, z;
+};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class LeptoParser{
+  std::istream&            in;
+  std::string              line;
+  std::vector<std::string> field;
+  std::vector<LeptoRecord> event_array;
+  double                   z_vertex;
+  int                      event_index;
+  int                      num;
+  long                     n_lines;
+
+  void               splitLine();
+  const std::string& getField(unsigned int i);
+  double             getNumber(unsigned int i);
+  const LeptoRecord* getRecord(long i);
+  int                findParentID(int orig);
+
+public:
+  LeptoParser(std::istream& input, double z_vertex);
+  ~LeptoParser();
+
+  // Reads the next event listing and stores its final-state particles. Returns false at the end of the input.
+  bool nextEvent(std::vector<ThrownParticle>& particles);
+
+  int  getNfinal()	{return num;}
+  long getNlines()	{return n_lines;}
+};
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+inline LeptoParser::LeptoParser(std::istream& input, double z) : in(input), z_vertex(z), event_index(0), num(0), n_lines(0){
+  // Class constructor
+  field.reserve(16);
+  event_array.reserve(64);
+}
+
+inline LeptoParser::~LeptoParser(){}
+
+inline void LeptoParser::splitLine(){
+  // Mimics perl's split(/ +/) : a leading space produces an empty first field, so the
+  // field numbering below is the same one used in lepto2dat.pl
+  field.clear();
+  std::string::size_type pos = 0;
+  while(true){
+    std::string::size_type next = line.find(' ', pos);
+    if(next == std::string::npos){
+      field.emplace_back(line, pos);
+      break;
+    }
+    if(next > pos || pos == 0) field.emplace_back(line, pos, next - pos);
+    pos = line.find_first_not_of(' ', next);
+    if(pos == std::string::npos) break;
+  }
+}
+
+inline const std::string& LeptoParser::getField(unsigned int i){
+  // Missing fields behave like perl's undef
+  static const std::string empty;
+  return (i < field.size()) ? field[i] : empty;
+}
+
+inline double LeptoParser::getNumber(unsigned int i){
+  // Numeric value of a field. Like perl, only the leading numeric part counts, anything else is 0
+  return std::strtod(getField(i).c_str(), nullptr);
+}
+
+inline const LeptoRecord* LeptoParser::getRecord(long i){
+  // Perl array access : negative indices count from the end, out of range gives undef (nullptr)
+  if(i < 0) i += (long) event_array.size();
+  if(i < 0 || i >= (long) event_array.size()) return nullptr;
+  return &event_array[i];
+}
+
+inline int LeptoParser::findParentID(int orig){
+  // find parent id up to 2 consecutive decays
+  // last decay
+  const LeptoRecord* parent = getRecord(orig - 1);
+  int parent_KS = parent ? parent->KS : 0;
+  int parent_id = parent ? parent->KF : 0;
+  // exclude strings, clusters or particles with KS different than 11
+  if(parent_KS != 11 || parent_id == 91) parent_id = 0;
+
+  // second to last decay
+  int gparent_index = parent ? parent->orig : 0;
+  const LeptoRecord* gparent = getRecord(gparent_index - 1);
+  int gparent_KS = gparent ? gparent->KS : 0;
+  int gparent_id = gparent ? gparent->KF : 0;
+  // exclude strings, clusters or particles with KS different than 11
+  if(gparent_KS != 11 || gparent_id == 91 || gparent_id == 92) gparent_id = 0;
+
+  // if there was a "valid" grand-parent id, return that one instead
+  return (gparent_id != 0) ? gparent_id : parent_id;
+}
+
+inline bool LeptoParser::nextEvent(std::vector<ThrownParticle>& particles){
+  particles.clear();
+  event_array.clear();
+  num = 0;
+
+  bool skip = true;
+  while(std::getline(in, line)){
+    n_lines++;
+    splitLine();
+    const std::string& f1 = getField(1);
+
+    // skip top part of the file until finding "Event listing"
+    if(f1 == "Event" && getField(2) == "listing") skip = false;
+    if(skip) continue;
+
+    if(f1 != "I" && f1 != "sum:" && getNumber(1) > 0){
+      LeptoRecord r;
+      const std::string& f3 = getField(3);
+      if(f3 == "A" || f3 == "V"){ // these letters move all fields in one index
+	r = {(int) getNumber(1), (int) getNumber(4), (int) getNumber(5), (int) getNumber(6), getNumber(10), getNumber(7), getNumber(8), getNumber(9)};
+      } else{
+	r = {(int) getNumber(1), (int) getNumber(3), (int) getNumber(4), (int) getNumber(5), getNumber(9), getNumber(6), getNumber(7), getNumber(8)};
+      }
+      // count only final-state particles (KS == 1 refers to final state particle)
+      if(getNumber(3) == 1) num++;
+      event_array.push_back(r);
+    }
+
+    // finished the event, keep final-state particles
+    if(f1 == "sum:"){
+      for(const LeptoRecord& r : event_array){
+	if(r.KS != 1) continue;
+	// if the electron is a final state particle the event index is increased by one
+	if(r.KF == 11) ++event_index;
+	particles.push_back({event_index, r.KF, findParentID(r.orig), r.Px, r.Py, r.Pz, r.E, 0., 0., z_vertex});
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
+
+#endif
@@ -0,0 +1,152 @@
+// LUND and ntuple shards of one LEPTO run (--shards=N), so a single generation feeds N GEMC jobs
+// The event listings are split in N ranges of consecutive events with about the same number of particles, the work
+// of GEMC, and shard k is written to <lund>_k.dat and <output>_k.root (getShardName).
+// The events keep the numbers of the whole run : the ntuples of shard k start at the events of the shards before it,
+// and the sampled vertices (vertex_sampler.h) are keyed by the listing number in the run, as without --shards.
+// The input is parsed twice : first to count the particles of every listing, then to write the shards one after the other.
+
+// author : Esteban Molina
+
+#ifndef LUND_SHARDS_H
+#define LUND_SHARDS_H
+
+#include "thrown_filler.h"
+#include "options.h"
+#include "TFile.h"
+#include "TROOT.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+std::vector<size_t> getShardStarts(const std::vector<int>& n_particles, int n_shards){
+  // First listing of every shard (and the number of listings at the end), so that the shards have about
+  // total/n_shards particles each. No shard is empty while there are listings left
+  std::vector<unsigned long long> sum(n_particles.size() + 1, 0);
+  for(size_t i = 0 ; i < n_particles.size() ; i++) sum[i + 1] = sum[i] + n_particles[i];
+
+  std::vector<size_t> starts(1, 0);
+  for(int k = 1 ; k < n_shards ; k++){
+    unsigned long long target = sum.back()*k/n_shards;
+    size_t start = std::lower_bound(sum.begin(), sum.end(), target) - sum.begin();
+    // Closest boundary to the target
+    if(start > 0 && target - sum[start - 1] < sum[start] - target) start--;
+    size_t min_start = starts.back() + 1;
+    size_t max_start = n_particles.size() - std::min(n_particles.size(), (size_t) (n_shards - k));
+    starts.push_back(std::min(n_particles.size(), std::max(min_start, std::min(start, max_start))));
+  }
+  starts.push_back(n_particles.size());
+  return starts;
+}
+
+template<class Run>
+int convertShards(const Options& opt, const Run& run, JobReport* report){
+  // Returns 0 on success, 1 otherwise
+
+  // First pass : particles and events of every listing
+  std::vector<int> n_particles, n_events;
+  {
+    StageTimer read_timer(report, kStageRead);
+    std::ifstream file(opt.file_in);
+    if(!file.is_open()){
+      std::cout<<"Could not open "<<opt.file_in<<std::endl;
+      return 1;
+    }
+    LeptoParser parser(file, run.getZvertex());
+    std::vector<ThrownParticle> particles;
+    while(parser.nextEvent(particles)){
+      n_particles.push_back(particles.size());
+      n_events.push_back(countEvents(particles));
+    }
+  }
+  std::vector<size_t> starts = getShardStarts(n_particles, opt.shards);
+
+  std::vector<HistogramConfig> histogram_configs;
+  if(!opt.histograms.empty() && !readHistogramConfig(opt.histograms, histogram_configs)) return 1;
+  Selection selection;
+  if(!opt.select.empty() && !selection.compile(opt.select)) return 1;
+  const Selection* cuts = opt.select.empty() ? 0 : &selection;
+  VertexSampler vertex(opt.job_id, opt.z_min, opt.z_max);
+
+  // Second pass : every shard is converted with the output open, as in streaming mode
+  std::ifstream file(opt.file_in);
+  LeptoParser parser(file, run.getZvertex());
+  std::vector<ThrownParticle> particles;
+  Long64_t first_event = 0;
+  for(int k = 0 ; k < opt.shards ; k++){
+    std::string file_out = getShardName(opt.file_out, k);
+    std::string lund_out = getShardName(opt.lund_out, k);
+
+    // Closed and deleted on every return
+    OutputFile f(new TFile(file_out.c_str(), "RECREATE", "", getCompressionSettings(opt)));
+    if(f->IsZombie()){
+      std::cout<<"Could not create "<<file_out<<std::endl;
+      return 1;
+    }
+    f->cd();
+    std::unique_ptr<HistogramSet> histograms(histogram_configs.empty() ? 0 : new HistogramSet(histogram_configs));
+    std::unique_ptr<ThrownOutput> output(bookThrownOutput(opt, f.get(), histograms.get(), cuts));
+    output->setFirstEvent(first_event);
+    output->setReport(report);
+
+    LundWriter lund(lund_out.c_str(), opt.beam_energy, opt.beam_energy_text);
+    if(!lund.isOpen()){
+      std::cout<<"Could not open "<<lund_out<<std::endl;
+      return 1;
+    }
+    EventIndex lund_index(kIndexLund);
+    if(opt.index) lund.setIndex(&lund_index);
+
+    {
+      ThrownFiller<Run> filler(output.get(), run, opt.kinematics, cuts);
+      for(size_t listing = starts[k] ; listing < starts[k + 1] ; listing++){
+	StageTimer read_timer(report, kStageRead);
+	if(!parser.nextEvent(particles) || particles.size() != (size_t) n_particles[listing]){
+	  std::cout<<opt.file_in<<" changed while converting it"<<std::endl;
+	  return 1;
+	}
+	if(opt.sample_vertex) sampleVertex(vertex, listing, particles.data(), particles.size());
+	read_timer.stop();
+
+	StageTimer write_timer(report, kStageWrite);
+	lund.writeEvent(particles, parser.getNfinal());
+	write_timer.stop();
+
+	StageTimer fill_timer(report, kStageKinematics);
+	for(const ThrownParticle& p : particles) filler.fill(p);
+	first_event += n_events[listing];
+      }
+      StageTimer fill_timer(report, kStageKinematics);
+      filler.flush();
+    }
+
+    StageTimer write_timer(report, kStageWrite);
+    f->cd();
+    output->write();
+    output.reset();
+    if(histograms) histograms->write();
+    histograms.reset();
+    f.reset();
+    write_timer.stop();
+
+    if(!lund.close()){
+      std::cout<<"Could not write "<<lund_out<<std::endl;
+      return 1;
+    }
+    if(opt.index && !lund_index.write(getIndexName(lund_out), lund_out)){
+      std::cout<<"Could not write "<<getIndexName(lund_out)<<", build it with event_index"<<std::endl;
+    }
+    std::cout<<"Shard "<<k<<" : listings "<<starts[k]<<" to "<<starts[k + 1]<<" in "<<lund_out<<" and "<<file_out<<std::endl;
+  }
+
+  return 0;
+}
+
+#endif
@@ -0,0 +1,125 @@
+// LUND writer for GEMC input
+// Port of the printing done in leptoLUND.pl, so the ntuples and the LUND file come from the same parse
+// The header has the beam energy as the script prints it : the text of its argument, or the number as Perl prints it
+// (15 significant digits) when there is no text
+// With an EventIndex, the position of every event is recorded as it is written (event_index.h)
+// File names ending in .gz or .zst are written compressed (compressed_io.h)
+
+// author : Esteban Molina
+
+#ifndef LUND_WRITER_H
+#define LUND_WRITER_H
+
+#include "lepto_parser.h"
+#include "event_index.h"
+#include "compressed_io.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class LundWriter{
+  FILE*       out;
+  bool        owner;
+  std::string file_name;
+  std::string beam_energy;	// text of the header
+  long        n_events;
+  uint64_t    n_bytes;
+  EventIndex* positions;	// event index of the file, if recorded
+
+public:
+  // beam_energy_text (--beam_energy as given) is printed in the header if set, beam_energy otherwise
+  LundWriter(const char* file_name, double beam_energy, const std::string& beam_energy_text = "");
+  LundWriter(FILE* stream, double beam_energy, const std::string& beam_energy_text = "");	// writes to an already open stream, which is not closed
+  ~LundWriter();
+
+  bool isOpen()		{return out != nullptr;}
+  long getNevents()	{return n_events;}
+  void setIndex(EventIndex* i)	{positions = i;}
+  // Closes the file before the writer is deleted. False if a write or the close failed (full disk, zstd error, ...)
+  bool close();
+
+  void writeEvent(const std::vector<ThrownParticle>& particles, int n_final);
+  void writeEvent(const ThrownParticle* particles, size_t n, int n_final);
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+std::string getLundBeamEnergy(double beam_energy, const std::string& beam_energy_text){
+  // Beam energy of the LUND header, as leptoLUND.pl prints its argument
+  if(!beam_energy_text.empty()) return beam_energy_text;
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.15g", beam_energy);
+  return text;
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+LundWriter::LundWriter(const char* name, double energy, const std::string& energy_text) : owner(true), file_name(name),
+  beam_energy(getLundBeamEnergy(energy, energy_text)), n_events(0), n_bytes(0), positions(0){
+  // Class constructor
+  out = openOutputFile(file_name);
+}
+
+LundWriter::LundWriter(FILE* stream, double energy, const std::string& energy_text) : out(stream), owner(false),
+  beam_energy(getLundBeamEnergy(energy, energy_text)), n_events(0), n_bytes(0), positions(0){}
+
+LundWriter::~LundWriter(){
+  close();
+}
+
+bool LundWriter::close(){
+  bool ok = !out || !owner || closeOutputFile(out, file_name) == 0;
+  out = nullptr;
+  return ok;
+}
+
+void LundWriter::writeEvent(const std::vector<ThrownParticle>& particles, int n_final){
+  writeEvent(particles.data(), particles.size(), n_final);
+}
+
+void LundWriter::writeEvent(const ThrownParticle* particles, size_t n, int n_final){
+  // Print LUND header
+  // Used by gemc : Number of particles -> 1st arg
+  //                Beam Polarization   -> 5th arg
+  if(positions) positions->addEvent(n_bytes, n, n + 1);
+  n_bytes += std::fprintf(out, "%d 0.0 0.0 0.0 0.0 11 %s 0.0 0.0 0.0\n", n_final, beam_energy.c_str());
+
+  // Print LUND particles
+  //                     Name              Position
+  // Used by gemc : index                     1st
+  //                type(1 is active)         3rd
+  //                particle ID (pdg)         4th
+  //                px                        7th
+  //                py                        8th
+  //                pz                        9th
+  //                x                         12th
+  //                y                         13th
+  //                z                         14th
+  //________________________________________________
+  // Optionals    : Lifetime                  2nd
+  //                Index of parent           5th
+  //                Index of first daughter   6th (final state particle detection makes it useless)
+  //                Energy of particle Gev    10th
+  //                Mass of the particle GeV  11th
+  int index = 1;
+  for(const ThrownParticle* p_end = particles + n ; particles != p_end ; particles++){
+    const ThrownParticle& p = *particles;
+    n_bytes += std::fprintf(out, "%4d 0.0 1 %4d %4d %4d %9.7f %9.7f %9.7f %9.7f 0.0 %9.7f %9.7f %9.7f\n",
+		 index, p.PID, p.parent_PID, 0, p.Px, p.Py, p.Pz, p.E, p.x, p.y, p.z);
+    ++index;
+  }
+
+  n_events++;
+  if(positions) positions->setSize(n_bytes);
+}
+
+#endif
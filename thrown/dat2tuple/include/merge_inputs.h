@@ -0,0 +1,281 @@
+// Merge mode (--merge) : many inputs into a single output, replacing the conversion + hadd step of the array jobs
+//   <input_file_name> is a glob ("lepto_out_*_ntuple.root") or @<list>, a text file with one input per line
+//   .dat inputs  : converted in parallel (--threads), one input per worker, merged in input order
+//   .root inputs : thrown ntuples of previous dat2tuple runs, copied with fast cloning (compressed baskets are
+//                  not decompressed), while the next inputs are opened in the background
+// Both ntuples get an extra "job" column so the events stay unique across inputs. The job id is the last number
+// in the file name (the array task id in lepto_out_<id>_ntuple.root), or the position in the list when there is none.
+
+// author : Esteban Molina
+
+#ifndef MERGE_INPUTS_H
+#define MERGE_INPUTS_H
+
+#include "thrown_filler.h"
+#include "options.h"
+#include "ROOT/TBufferMerger.hxx"
+#include "TFile.h"
+#include "TROOT.h"
+
+#include <glob.h>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const char* const kMergedNtuples[2] = {"ntuple_thrown", "ntuple_thrown_electrons"};
+
+//####################################################################################################################//
+//########################################         DATA RECORDS          #############################################//
+//####################################################################################################################//
+
+struct MergeInput{
+  std::string file_name;
+  int         job_id;
+  Long64_t    n_entries[2];	// rows contributed to ntuple_thrown and ntuple_thrown_electrons
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+std::vector<std::string> expandInputs(const std::string& pattern){
+  // Returns the files of a glob or of an @list file
+  std::vector<std::string> files;
+  if(!pattern.empty() && pattern[0] == '@'){
+    std::ifstream list(pattern.substr(1));
+    std::string line;
+    while(std::getline(list, line)){
+      size_t first = line.find_first_not_of(" \t\r");
+      if(first == std::string::npos || line[first] == '#') continue;
+      size_t last = line.find_last_not_of(" \t\r");
+      files.push_back(line.substr(first, last - first + 1));
+    }
+    return files;
+  }
+
+  glob_t matches;
+  if(glob(pattern.c_str(), 0, 0, &matches) == 0){
+    for(size_t i = 0 ; i < matches.gl_pathc ; i++) files.push_back(matches.gl_pathv[i]);
+  }
+  globfree(&matches);
+  return files;
+}
+
+int getJobId(const std::string& file_name, int position){
+  // Last number in the base name of the file, position if there is none
+  std::string base = file_name.substr(file_name.find_last_of('/') + 1);
+  int end = (int) base.size() - 1;
+  while(end >= 0 && !std::isdigit((unsigned char) base[end])) end--;
+  if(end < 0) return position;
+  int begin = end;
+  while(begin > 0 && std::isdigit((unsigned char) base[begin - 1])) begin--;
+  return std::atoi(base.substr(begin, end - begin + 1).c_str());
+}
+
+bool hasExtension(const std::string& file_name, const std::string& extension){
+  return file_name.size() >= extension.size() && file_name.compare(file_name.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+template<class Run>
+bool mergeDatInputs(const Options& opt, const Run& run, std::vector<MergeInput>& inputs, JobReport* report){
+  // Converts every .dat input in its own TBufferMerger file, queued in input order
+  // Every input is checked before the output is created, as a conversion of a missing input does not start
+  for(const MergeInput& input : inputs){
+    if(!std::ifstream(input.file_name).is_open()){
+      std::cout<<"Could not open "<<input.file_name<<std::endl;
+      return false;
+    }
+  }
+
+  ROOT::EnableThreadSafety();
+  ROOT::TBufferMerger merger(opt.file_out.c_str(), "RECREATE", getCompressionSettings(opt));
+
+  std::atomic<int>        next_input(0);
+  std::atomic<bool>       failed(false);
+  int                     next_to_write = 0;
+  std::mutex              write_mutex;
+  std::condition_variable write_turn;
+
+  auto worker = [&](){
+    for(int i = next_input++ ; i < (int) inputs.size() ; i = next_input++){
+      JobReport  input_report;
+      JobReport* local = report ? &input_report : 0;
+
+      auto f = merger.GetFile();
+      f->cd();
+      ThrownOutput* output = bookThrownOutput(opt);
+      output->setReport(local);
+
+      if(opt.reader == "fast"){
+	FastDatReader reader(inputs[i].file_name.c_str());
+	if(!reader.isOpen()){
+	  std::cout<<"Could not open "<<inputs[i].file_name<<std::endl;
+	  failed = true;
+	}
+	else{
+	  ThrownFiller<Run> filler(output, run, opt.kinematics);
+	  fillFromRows(reader, filler);
+	}
+      }
+      else{
+	std::ifstream file(inputs[i].file_name);
+	if(!file.is_open()){
+	  std::cout<<"Could not open "<<inputs[i].file_name<<std::endl;
+	  failed = true;
+	}
+	else{
+	  ThrownFiller<Run> filler(output, run, opt.kinematics);
+	  fillFromStream(file, "dat", run, filler, 0);
+	}
+      }
+      inputs[i].n_entries[0] = output->getHadronTree()->GetEntries();
+      inputs[i].n_entries[1] = output->getElectronTree()->GetEntries();
+      delete output;
+
+      std::unique_lock<std::mutex> lock(write_mutex);
+      write_turn.wait(lock, [&](){return next_to_write == i;});
+      StageTimer write_timer(local, kStageWrite);
+      f->Write();
+      write_timer.stop();
+      next_to_write++;
+      lock.unlock();
+      write_turn.notify_all();
+
+      if(report) report->merge(input_report);
+    }
+  };
+
+  int n_threads = std::min(opt.threads, (int) inputs.size());
+  std::vector<std::thread> pool;
+  for(int i = 0 ; i < n_threads ; i++) pool.emplace_back(worker);
+  for(std::thread& thread : pool) thread.join();
+
+  return !failed;
+}
+
+bool mergeRootInputs(const Options& opt, std::vector<MergeInput>& inputs, JobReport* report){
+  // Copies the thrown ntuples of every input with fast cloning
+  ROOT::EnableThreadSafety();
+  // Closed and deleted on every return
+  OutputFile f_out(new TFile(opt.file_out.c_str(), "RECREATE", "", getCompressionSettings(opt)));
+  if(f_out->IsZombie()){
+    std::cout<<"Could not create "<<opt.file_out<<std::endl;
+    return false;
+  }
+
+  // The next inputs are opened while the current one is copied
+  const int n_ahead = std::max(1, opt.threads);
+  std::vector<std::future<TFile*>> opened(inputs.size());
+  auto open_input = [&](int i){
+    if(i < (int) inputs.size()) opened[i] = std::async(std::launch::async, [&inputs, i](){return TFile::Open(inputs[i].file_name.c_str());});
+  };
+  for(int i = 0 ; i < n_ahead ; i++) open_input(i);
+
+  TTree* out[2] = {0, 0};
+  bool ok = true;
+  for(int i = 0 ; i < (int) inputs.size() ; i++){
+    open_input(i + n_ahead);
+    StageTimer read_timer(report, kStageRead);
+    TFile* f_in = opened[i].get();
+    read_timer.stop();
+    if(!f_in || f_in->IsZombie()){
+      std::cout<<"Could not open "<<inputs[i].file_name<<std::endl;
+      ok = false;
+      delete f_in;
+      continue;
+    }
+
+    for(int k = 0 ; k < 2 ; k++){
+      TTree* in = f_in->Get<TTree>(kMergedNtuples[k]);
+      inputs[i].n_entries[k] = 0;
+      if(!in){
+	std::cout<<inputs[i].file_name<<" has no "<<kMergedNtuples[k]<<std::endl;
+	ok = false;
+	continue;
+      }
+      // Baskets are copied without being decompressed, the copy goes to the write stage
+      StageTimer write_timer(report, kStageWrite);
+      f_out->cd();
+      if(!out[k]) out[k] = in->CloneTree(0);
+      inputs[i].n_entries[k] = out[k]->CopyEntries(in, -1, "fast");
+      // Do not leave the output pointing to the buffers of the closed input
+      in->CopyAddresses(out[k], true);
+    }
+    f_in->Close();
+    delete f_in;
+  }
+  for(std::future<TFile*>& f : opened){
+    if(f.valid()) delete f.get();
+  }
+
+  StageTimer write_timer(report, kStageWrite);
+  f_out->cd();
+  for(TTree* t : out){
+    if(t) t->Write();
+  }
+  f_out.reset();
+  return ok;
+}
+
+bool addJobColumn(const std::string& file_out, const std::vector<MergeInput>& inputs){
+  // Adds the "job" branch to both ntuples of the merged file, the rows of each input are contiguous
+  // Ntuples merged from outputs of a previous merge already have it, with the job of every row : it is kept
+  TFile f(file_out.c_str(), "UPDATE");
+  if(f.IsZombie()) return false;
+
+  for(int k = 0 ; k < 2 ; k++){
+    TTree* t = f.Get<TTree>(kMergedNtuples[k]);
+    if(!t) return false;
+    if(t->GetBranch("job")) continue;
+    Int_t job;
+    TBranch* b = t->Branch("job", &job, "job/I");
+    for(const MergeInput& input : inputs){
+      job = input.job_id;
+      for(Long64_t entry = 0 ; entry < input.n_entries[k] ; entry++) b->Fill();
+    }
+    t->Write("", TObject::kOverwrite);
+  }
+  f.Close();
+  return true;
+}
+
+template<class Run>
+int convertMerge(const Options& opt, const Run& run, JobReport* report){
+  // Returns 0 on success, 1 otherwise
+  std::vector<std::string> files = expandInputs(opt.file_in);
+  if(files.empty()){
+    std::cout<<"No inputs match "<<opt.file_in<<std::endl;
+    return 1;
+  }
+
+  std::vector<MergeInput> inputs;
+  int n_root = 0;
+  for(int i = 0 ; i < (int) files.size() ; i++){
+    inputs.push_back({files[i], getJobId(files[i], i), {0, 0}});
+    if(hasExtension(files[i], ".root")) n_root++;
+    if(report) report->addBytesIn(getFileBytes(files[i]));
+  }
+  if(n_root != 0 && n_root != (int) files.size()){
+    std::cout<<"Merge inputs have to be all .dat or all .root files"<<std::endl;
+    return 1;
+  }
+
+  bool ok = (n_root > 0) ? mergeRootInputs(opt, inputs, report) : mergeDatInputs(opt, run, inputs, report);
+  StageTimer job_timer(report, kStageWrite);
+  if(!ok || !addJobColumn(opt.file_out, inputs)){
+    std::cout<<"Merge into "<<opt.file_out<<" failed"<<std::endl;
+    return 1;
+  }
+
+  std::cout<<"Merged "<<inputs.size()<<" inputs into "<<opt.file_out<<std::endl;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,21 @@
+// Resource monitoring helpers for dat2tuple
+
+// author : Esteban Molina
+
+#ifndef MONITORING_H
+#define MONITORING_H
+
+#include <sys/resource.h>
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+double getPeakRSS(){
+  // Returns the peak resident set size of the process in MB (ru_maxrss is given in kB on Linux)
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) != 0) return 0.;
+  return usage.ru_maxrss/1024.;
+}
+
+#endif
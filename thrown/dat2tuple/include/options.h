@@ -0,0 +1,338 @@
+// Command line options of dat2tuple
+// usage : ./dat2tuple <input_file_name> <output_file_name> [--option=value ...]
+
+// author : Esteban Molina
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "constants.h"
+#include "vertex_sampler.h"
+#include "compressed_io.h"
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <sys/stat.h>
+
+//####################################################################################################################//
+//########################################         OPTIONS STRUCT        #############################################//
+//####################################################################################################################//
+
+struct Options{
+  std::string file_in;
+  std::string file_out;
+  std::string input    = "dat";	// dat    : file formated by lepto2dat.pl
+				// lepto  : raw LEPTO output (Event listing blocks)
+				// binary : binary event file (binary_format.h)
+  bool        input_set = false;	// --input given, otherwise the format of a pipe is guessed (pipe_input.h)
+  double      z_vertex = 0.;	// vertex (cm) stamped on every particle when reading LEPTO output
+  bool        sample_vertex = false;	// sample the vertex of every LEPTO event in [z_min, z_max] (vertex_sampler.h)
+  double      z_min = 0., z_max = 0.;	// z range (cm) of the sampled vertices
+  unsigned long long job_id = 0;	// key of the vertex sampler
+  std::string lund_out;		// if set, LUND file for GEMC written from the same LEPTO parse
+  int         shards   = 1;	// LUND and ntuple shards written from the LEPTO input (lund_shards.h)
+  bool        index    = false;	// write the event index of the LUND file (<lund>.idx, event_index.h)
+  std::string binary_out;	// if set, binary event file written from the same read
+  double      beam_energy = kEbeam;	// beam energy (GeV) used in the kinematics and the LUND header
+  std::string beam_energy_text;	// --beam_energy as given, printed in the LUND header as leptoLUND.pl does
+  double      target_mass = kMassProton;	// target mass (GeV) used in the kinematics
+  std::string reader   = "legacy";	// legacy : TTree::ReadFile (iostream rows in streaming mode)
+				// fast   : mapped file parsed with std::from_chars, no intermediate tree
+  bool        stream   = false;	// open the output first and flush baskets while converting
+  double      max_memory = 256.;	// memory (MB) the output baskets may take in streaming mode
+  std::string kinematics = "reference";	// reference : LeptonicKinematics/HadronicKinematics per row
+					// fused     : electron and virtual photon frame once per event (hadron_frame.h)
+					// batch     : vectorized kernels over blocks of rows
+  int         threads  = 1;	// worker threads, more than 1 converts chunks of the input in parallel
+  double      chunk_size = 32.;	// size (MB) of the input chunks given to the worker threads
+  bool        merge    = false;	// input is a glob or @list of .dat/.root files merged into one output
+  std::string schema   = "ntuple";	// ntuple : all-float TNtuples
+					// typed  : TTrees with Long64_t event, Int_t pid and float/double kinematics
+					// event  : one entry per event with the hadrons as arrays (event_output.h)
+  std::string precision = "float";	// float or double kinematics in the typed and event schemas
+  std::string compression;		// zlib, lz4, zstd or lzma (empty keeps the ROOT default)
+  int         compression_level = -1;	// level of the compression algorithm (-1 keeps its default)
+  int         basket_size = 0;		// basket size (bytes) of every branch (0 keeps the ROOT default)
+  std::string backend  = "ttree";	// ttree   : TNtuple/TTree output (--schema)
+				// rntuple : RNTuple output with the columns of the typed schema
+  bool        raw      = false;	// also write the input rows (ntuple_thrown_raw)
+  long long   auto_flush  = 0;		// auto-flush of the trees, >0 entries and <0 bytes (0 keeps the default)
+  std::string histograms;		// config file of the sparse histograms filled while converting (histogram_output.h)
+  bool        no_ntuples = false;	// only write the histograms
+  std::string select;			// cuts of the rows written (selection.h), empty : every row
+  bool        incremental = false;	// skip the conversion if the manifest has the output up to date (conversion_cache.h)
+  std::string manifest;			// manifest of --incremental, empty : dat2tuple.manifest next to the output
+  std::string report;			// JSON report of the job (job_report.h), empty : <output>.report.json, none : no report
+  std::string batch;			// manifest of the jobs converted in this process (batch_runner.h)
+  int         retries  = 2;		// times a failed job of --batch is run again
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+void printUsage(){
+  std::cout<<"Usage : ./dat2tuple <input_file_name> <output_file_name> [options]"<<std::endl;
+  std::cout<<"        ./dat2tuple --batch=<manifest> [options]"<<std::endl;
+  std::cout<<"  <input_file_name> can be - (stdin) or a FIFO, read as the events arrive (format guessed without --input)"<<std::endl;
+  std::cout<<"  <input_file_name> can be gzip or zstd compressed, it is decompressed by another thread while converting"<<std::endl;
+  std::cout<<"  --input=dat|lepto|binary  format of the input file (default dat)"<<std::endl;
+  std::cout<<"  --z_vertex=<cm>      z vertex stamped on the particles when reading LEPTO output (default 0)"<<std::endl;
+  std::cout<<"  --lD2_length=<1-5>   sample the z vertex of every LEPTO event in the cryotarget of that length (cm), replaces --z_vertex"<<std::endl;
+  std::cout<<"  --z_range=<min>,<max>  sample the z vertex of every LEPTO event in [min, max] (cm), replaces --z_vertex"<<std::endl;
+  std::cout<<"  --job_id=<N>         key of the sampled vertices, the same job id gives the same vertices (default 0)"<<std::endl;
+  std::cout<<"  --lund=<file>        also write the LUND file for GEMC (needs --input=lepto), gzip or zstd compressed if it ends in .gz or .zst"<<std::endl;
+  std::cout<<"  --shards=<N>         write N LUND and ntuple shards balanced by particles, <name>_<k>.dat and <name>_<k>.root (needs --lund)"<<std::endl;
+  std::cout<<"  --index              also write the event index of the LUND file (<lund_file>.idx) for event_index"<<std::endl;
+  std::cout<<"  --reader=legacy|fast  .dat parsing with TTree::ReadFile or the mapped from_chars reader (default legacy)"<<std::endl;
+  std::cout<<"  --binary=<file>      also write the particles in the binary event format"<<std::endl;
+  std::cout<<"  --beam_energy=<GeV>  beam energy (default "<<kEbeam<<")"<<std::endl;
+  std::cout<<"  --target_mass=<GeV>  target mass used in xB and W (default proton mass)"<<std::endl;
+  std::cout<<"  --kinematics=reference|fused|batch  per-row classes, fused per-event frame or vectorized blocks (default reference)"<<std::endl;
+  std::cout<<"  --stream             bounded memory conversion, the raw tree is never built"<<std::endl;
+  std::cout<<"  --max_memory=<MB>    memory ceiling of the output baskets in streaming mode (default 256)"<<std::endl;
+  std::cout<<"  --threads=<N>        convert chunks of the input in N threads, same output as with 1 (default 1)"<<std::endl;
+  std::cout<<"  --chunk_size=<MB>    size of the chunks given to the threads (default 32)"<<std::endl;
+  std::cout<<"  --backend=ttree|rntuple  output as TNtuple/TTree or as RNTuple (default ttree)"<<std::endl;
+  std::cout<<"  --raw                also write the input rows (ntuple_thrown_raw)"<<std::endl;
+  std::cout<<"  --schema=ntuple|typed|event all-float TNtuples, typed trees with event index and integer pid, or one entry per event with hadron arrays (default ntuple)"<<std::endl;
+  std::cout<<"  --precision=float|double  kinematics precision of the typed and event schemas (default float)"<<std::endl;
+  std::cout<<"  --compression=zlib|lz4|zstd|lzma  compression algorithm of the output (default ROOT's)"<<std::endl;
+  std::cout<<"  --compression_level=<N>  compression level (default of the algorithm)"<<std::endl;
+  std::cout<<"  --basket_size=<bytes>  basket size of the output branches"<<std::endl;
+  std::cout<<"  --auto_flush=<N>     auto-flush of the output trees, >0 entries, <0 bytes"<<std::endl;
+  std::cout<<"  --select=\"<cuts>\"    write only the rows that pass the cuts, e.g. \"Q2>1 && W>2 && y<0.85 && zh>0.1 && pid==211\""<<std::endl;
+  std::cout<<"  --histograms=<config>  also fill the sparse histograms defined in the config file"<<std::endl;
+  std::cout<<"  --no_ntuples         write only the histograms"<<std::endl;
+  std::cout<<"  --incremental        skip the conversion if the output is up to date with the inputs and options"<<std::endl;
+  std::cout<<"  --manifest=<file>    manifest of --incremental (default dat2tuple.manifest next to the output)"<<std::endl;
+  std::cout<<"  --report=<file>|none  JSON report with stage timers and counters (default <output>.report.json)"<<std::endl;
+  std::cout<<"  --batch=<manifest>   convert the jobs of the manifest, one \"<input> <output> [options]\" per line, the options of the"<<std::endl;
+  std::cout<<"                       command line apply to every job and --threads jobs run at once"<<std::endl;
+  std::cout<<"  --retries=<N>        times a failed job of --batch is run again (default 2)"<<std::endl;
+  std::cout<<"  --merge              <input_file_name> is a glob or @<list> of .dat or ntuple files merged into one output with a job column"<<std::endl;
+}
+
+bool isPipeInput(const Options& opt){
+  // stdin ("-") or a named pipe, see pipe_input.h
+  if(opt.file_in == "-") return true;
+  struct stat st;
+  return stat(opt.file_in.c_str(), &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+std::string getShardName(const std::string& file_name, int shard){
+  // file_name with _<shard> before its extension (LUNDlepto_out.dat -> LUNDlepto_out_3.dat, LUNDlepto_out.dat.gz -> LUNDlepto_out_3.dat.gz)
+  size_t slash = file_name.find_last_of('/');
+  size_t begin = (slash == std::string::npos) ? 0 : slash + 1;
+  size_t dot   = file_name.find_last_of('.');
+  if(dot != std::string::npos && dot > begin && getOutputCompression(file_name) != kNoCompression){
+    size_t previous = file_name.find_last_of('.', dot - 1);
+    if(previous != std::string::npos && previous > begin) dot = previous;
+  }
+  if(dot == std::string::npos || dot <= begin) dot = file_name.size();
+  return file_name.substr(0, dot) + "_" + std::to_string(shard) + file_name.substr(dot);
+}
+
+bool getOptionValue(const std::string& arg, const std::string& name, std::string& value){
+  // Matches "--name=value" and stores value
+  std::string prefix = "--" + name + "=";
+  if(arg.compare(0, prefix.size(), prefix) != 0) return false;
+  value = arg.substr(prefix.size());
+  return true;
+}
+
+bool parseOptions(int argc, char** argv, Options& opt){
+  // Returns false if the arguments can not be used
+  int n_positional = 0;
+  for(int i = 1 ; i < argc ; i++){
+    std::string arg = argv[i];
+    std::string value;
+
+    if(arg.compare(0, 2, "--") != 0){
+      if(n_positional == 0)      opt.file_in  = arg;
+      else if(n_positional == 1) opt.file_out = arg;
+      else                       return false;
+      n_positional++;
+    }
+    else if(getOptionValue(arg, "input", value)){
+      if(value != "dat" && value != "lepto" && value != "binary"){
+	std::cout<<"Unknown input format "<<value<<std::endl;
+	return false;
+      }
+      opt.input     = value;
+      opt.input_set = true;
+    }
+    else if(getOptionValue(arg, "z_vertex", value))    opt.z_vertex    = std::atof(value.c_str());
+    else if(getOptionValue(arg, "lD2_length", value)){
+      int length = std::atoi(value.c_str());
+      if(length < 1 || length > kNcryoTargets){
+	std::cout<<"Unknown cryotarget length "<<value<<std::endl;
+	return false;
+      }
+      // mm to cm
+      opt.sample_vertex = true;
+      opt.z_min         = kCryoTargetZ[length - 1][0]/10.;
+      opt.z_max         = kCryoTargetZ[length - 1][1]/10.;
+    }
+    else if(getOptionValue(arg, "z_range", value)){
+      char* end = 0;
+      opt.z_min = std::strtod(value.c_str(), &end);
+      if(*end != ',' || (opt.z_max = std::strtod(end + 1, &end), *end != '\0') || opt.z_max <= opt.z_min){
+	std::cout<<"Wrong z range "<<value<<", use --z_range=<min>,<max>"<<std::endl;
+	return false;
+      }
+      opt.sample_vertex = true;
+    }
+    else if(getOptionValue(arg, "job_id", value))      opt.job_id      = std::strtoull(value.c_str(), 0, 10);
+    else if(getOptionValue(arg, "lund", value))        opt.lund_out    = value;
+    else if(getOptionValue(arg, "binary", value))      opt.binary_out  = value;
+    else if(getOptionValue(arg, "beam_energy", value)){
+      opt.beam_energy      = std::atof(value.c_str());
+      opt.beam_energy_text = value;
+    }
+    else if(getOptionValue(arg, "target_mass", value)) opt.target_mass = std::atof(value.c_str());
+    else if(getOptionValue(arg, "max_memory", value))  opt.max_memory  = std::atof(value.c_str());
+    else if(getOptionValue(arg, "threads", value))     opt.threads     = std::atoi(value.c_str());
+    else if(getOptionValue(arg, "batch", value))       opt.batch       = value;
+    else if(getOptionValue(arg, "retries", value))     opt.retries     = std::atoi(value.c_str());
+    else if(getOptionValue(arg, "shards", value))      opt.shards      = std::atoi(value.c_str());
+    else if(getOptionValue(arg, "chunk_size", value))  opt.chunk_size  = std::atof(value.c_str());
+    else if(getOptionValue(arg, "kinematics", value)){
+      if(value != "reference" && value != "fused" && value != "batch"){
+	std::cout<<"Unknown kinematics "<<value<<std::endl;
+	return false;
+      }
+      opt.kinematics = value;
+    }
+    else if(getOptionValue(arg, "schema", value)){
+      if(value != "ntuple" && value != "typed" && value != "event"){
+	std::cout<<"Unknown schema "<<value<<std::endl;
+	return false;
+      }
+      opt.schema = value;
+    }
+    else if(getOptionValue(arg, "precision", value)){
+      if(value != "float" && value != "double"){
+	std::cout<<"Unknown precision "<<value<<std::endl;
+	return false;
+      }
+      opt.precision = value;
+    }
+    else if(getOptionValue(arg, "compression", value)){
+      if(value != "zlib" && value != "lz4" && value != "zstd" && value != "lzma"){
+	std::cout<<"Unknown compression "<<value<<std::endl;
+	return false;
+      }
+      opt.compression = value;
+    }
+    else if(getOptionValue(arg, "compression_level", value)) opt.compression_level = std::atoi(value.c_str());
+    else if(getOptionValue(arg, "basket_size", value))       opt.basket_size       = std::atoi(value.c_str());
+    else if(getOptionValue(arg, "auto_flush", value))        opt.auto_flush        = std::atoll(value.c_str());
+    else if(getOptionValue(arg, "report", value))            opt.report            = value;
+    else if(getOptionValue(arg, "histograms", value))        opt.histograms        = value;
+    else if(getOptionValue(arg, "select", value))            opt.select            = value;
+    else if(getOptionValue(arg, "manifest", value))          opt.manifest          = value;
+    else if(getOptionValue(arg, "reader", value)){
+      if(value != "legacy" && value != "fast"){
+	std::cout<<"Unknown reader "<<value<<std::endl;
+	return false;
+      }
+      opt.reader = value;
+    }
+    else if(getOptionValue(arg, "backend", value)){
+      if(value != "ttree" && value != "rntuple"){
+	std::cout<<"Unknown backend "<<value<<std::endl;
+	return false;
+      }
+      opt.backend = value;
+    }
+    else if(arg == "--raw")                            opt.raw         = true;
+    else if(arg == "--stream")                         opt.stream      = true;
+    else if(arg == "--merge")                          opt.merge       = true;
+    else if(arg == "--no_ntuples")                     opt.no_ntuples  = true;
+    else if(arg == "--incremental")                    opt.incremental = true;
+    else if(arg == "--index")                          opt.index       = true;
+    else{
+      std::cout<<"Unknown option "<<arg<<std::endl;
+      return false;
+    }
+  }
+
+  // The format of a pipe without --input is only known once it is open (openPipeInput)
+  if(!opt.lund_out.empty() && opt.input != "lepto" && (opt.input_set || !isPipeInput(opt))){
+    std::cout<<"--lund needs the raw LEPTO output (--input=lepto)"<<std::endl;
+    return false;
+  }
+  if(opt.sample_vertex && opt.input != "lepto" && (opt.input_set || !isPipeInput(opt))){
+    std::cout<<"--lD2_length and --z_range sample the vertices of the raw LEPTO output (--input=lepto)"<<std::endl;
+    return false;
+  }
+  if(opt.index && (opt.lund_out.empty() || getOutputCompression(opt.lund_out) != kNoCompression)){
+    std::cout<<"--index writes the event index of the LUND file, it needs an uncompressed --lund"<<std::endl;
+    return false;
+  }
+  if(opt.shards < 1 || (opt.shards > 1 && (opt.input != "lepto" || opt.lund_out.empty() || isPipeInput(opt) || opt.threads > 1 ||
+					    opt.incremental))){
+    std::cout<<"--shards splits a LEPTO file (--input=lepto --lund=<file>) with one thread and without --incremental"<<std::endl;
+    return false;
+  }
+  if(opt.input == "binary" && (!opt.binary_out.empty() || opt.threads > 1)){
+    std::cout<<"--input=binary is converted with one thread and can not be written again with --binary"<<std::endl;
+    return false;
+  }
+  if(opt.merge && (opt.input != "dat" || !opt.lund_out.empty() || !opt.binary_out.empty())){
+    std::cout<<"--merge takes .dat or ntuple inputs only"<<std::endl;
+    return false;
+  }
+  if(opt.backend == "rntuple" && (opt.threads > 1 || opt.merge)){
+    std::cout<<"--backend=rntuple converts a single input with one thread"<<std::endl;
+    return false;
+  }
+  if(opt.schema == "event" && (opt.merge || opt.backend == "rntuple")){
+    std::cout<<"--schema=event is written with the ttree backend and without --merge"<<std::endl;
+    return false;
+  }
+  if(!opt.select.empty() && opt.merge){
+    std::cout<<"--select does not work with --merge, the ntuple inputs are copied without reading them"<<std::endl;
+    return false;
+  }
+  if((!opt.histograms.empty() && opt.merge) || (opt.no_ntuples && (opt.histograms.empty() || opt.raw))){
+    std::cout<<"--histograms does not work with --merge, --no_ntuples needs --histograms and no --raw"<<std::endl;
+    return false;
+  }
+  if(opt.incremental && isPipeInput(opt)){
+    std::cout<<"--incremental needs input files, pipes can not be hashed before converting them"<<std::endl;
+    return false;
+  }
+  if(opt.compression_level > 9 || (opt.compression_level >= 0 && opt.compression.empty())){
+    std::cout<<"--compression_level goes from 0 to 9 and needs --compression"<<std::endl;
+    return false;
+  }
+  if(opt.max_memory <= 0){
+    std::cout<<"--max_memory has to be positive"<<std::endl;
+    return false;
+  }
+  if(opt.threads < 1 || opt.chunk_size <= 0){
+    std::cout<<"--threads and --chunk_size have to be positive"<<std::endl;
+    return false;
+  }
+  if(opt.beam_energy <= 0 || opt.target_mass <= 0){
+    std::cout<<"--beam_energy and --target_mass have to be positive"<<std::endl;
+    return false;
+  }
+
+  if(!opt.batch.empty() && (!opt.lund_out.empty() || !opt.binary_out.empty() || (!opt.report.empty() && opt.report != "none"))){
+    std::cout<<"--lund, --binary and --report name the outputs of one job, give them on the lines of the --batch manifest"<<std::endl;
+    return false;
+  }
+  if(opt.retries < 0){
+    std::cout<<"--retries can not be negative"<<std::endl;
+    return false;
+  }
+
+  // The jobs of --batch have their files in the manifest
+  return opt.batch.empty() ? n_positional == 2 : n_positional == 0;
+}
+
+#endif
@@ -0,0 +1,226 @@
+// Multithreaded conversion (--threads=N)
+// The input is split in chunks that begin at an event boundary (event_chunks.h). The workers take the next
+// free chunk as soon as they are done with the previous one, so a slow chunk never stalls the others, and
+// each chunk is filled into its own in-memory file of a TBufferMerger.
+// The buffers (and the LUND text and binary events) are handed to the merger strictly in chunk order, so the output has the
+// same rows in the same order as the single-threaded conversion, whatever the number of threads.
+// Each chunk is read before it is filled, so the events are numbered as in a single-threaded run, and the sampled
+// vertices (vertex_sampler.h) are those of the single-threaded run : the LUND text is written once they are set.
+// LeptoParser numbers the rows (event_index) from 0 in every chunk : they are shifted by the final-state electrons of the
+// previous chunks, so the raw rows and the records of --binary have the event_index of the single-threaded run.
+// The LUND event index of every chunk (--index) is shifted by the LUND bytes of the previous ones.
+// Every chunk has its own job report, added to the one of the job when the chunk is done.
+// With --histograms every thread fills its own HistogramSet, the sets are added and written once the threads are done.
+
+// author : Esteban Molina
+
+#ifndef PARALLEL_CONVERT_H
+#define PARALLEL_CONVERT_H
+
+#include "thrown_filler.h"
+#include "event_chunks.h"
+#include "lund_writer.h"
+#include "options.h"
+#include "ROOT/TBufferMerger.hxx"
+#include "TROOT.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+template<class Run>
+int convertParallel(const Options& opt, const Run& run, JobReport* report){
+  // Returns 0 on success, 1 otherwise
+  ROOT::EnableThreadSafety();
+
+  std::vector<InputChunk> chunks = splitAtEvents(opt.file_in, opt.input, (long) (opt.chunk_size*1024.*1024.));
+  if(chunks.empty()){
+    std::cout<<"Could not open "<<opt.file_in<<std::endl;
+    return 1;
+  }
+
+  // Checked before any output is opened
+  std::vector<HistogramConfig> histogram_configs;
+  if(!opt.histograms.empty() && !readHistogramConfig(opt.histograms, histogram_configs)) return 1;
+  // Compiled once, read by all the threads
+  Selection selection;
+  if(!opt.select.empty() && !selection.compile(opt.select)) return 1;
+  const Selection* cuts = opt.select.empty() ? 0 : &selection;
+
+  FILE*      lund_file = 0;
+  EventIndex lund_index(kIndexLund);
+  uint64_t   lund_bytes = 0;
+  if(!opt.lund_out.empty()){
+    lund_file = openOutputFile(opt.lund_out);
+    if(!lund_file){
+      std::cout<<"Could not open "<<opt.lund_out<<std::endl;
+      return 1;
+    }
+  }
+
+  BinaryEventWriter* binary = 0;
+  if(!opt.binary_out.empty()){
+    binary = new BinaryEventWriter(opt.binary_out.c_str(), opt.beam_energy);
+    if(!binary->isOpen()){
+      std::cout<<"Could not open "<<opt.binary_out<<std::endl;
+      delete binary;
+      if(lund_file) closeOutputFile(lund_file, opt.lund_out);
+      return 1;
+    }
+  }
+
+  VertexSampler vertex(opt.job_id, opt.z_min, opt.z_max);
+
+  ROOT::TBufferMerger merger(opt.file_out.c_str(), "RECREATE", getCompressionSettings(opt));
+
+  std::atomic<int>        next_chunk(0);
+  std::atomic<bool>       failed(false);
+  int                     next_to_write = 0;
+  std::mutex              write_mutex;
+  std::condition_variable write_turn;
+  // Events (and LEPTO listings) in each chunk, known once the chunk is read, and used to number the events of the next ones
+  std::vector<Long64_t>   n_events(chunks.size(), -1);
+  std::vector<Long64_t>   n_listings(chunks.size(), -1);
+  std::vector<Long64_t>   n_electrons(chunks.size(), -1);
+  std::mutex              count_mutex;
+  std::condition_variable count_ready;
+
+  int n_threads = std::min(opt.threads, (int) chunks.size());
+  std::vector<HistogramSet*> histograms(n_threads, (HistogramSet*) 0);
+  for(int i = 0 ; i < n_threads && !histogram_configs.empty() ; i++) histograms[i] = new HistogramSet(histogram_configs);
+
+  auto worker = [&](int thread){
+    for(int i = next_chunk++ ; i < (int) chunks.size() ; i = next_chunk++){
+      JobReport  chunk_report;
+      JobReport* local = report ? &chunk_report : 0;
+
+      StageTimer read_timer(local, kStageRead);
+      std::string buffer = readChunk(opt.file_in, chunks[i]);
+      if(buffer.size() != (size_t) (chunks[i].end - chunks[i].begin)) failed = true;
+
+      std::vector<ThrownParticle> particles;
+      std::vector<size_t>         event_starts;
+      std::vector<int>            n_finals;
+      if(opt.input == "dat" && opt.reader == "fast"){
+	FastDatReader reader(buffer.data(), buffer.size());
+	readRows(reader, particles);
+      }
+      else{
+	std::istringstream in(buffer);
+	readParticles(in, opt.input, run.getZvertex(), particles, &event_starts, &n_finals);
+      }
+      std::string().swap(buffer);
+      read_timer.stop();
+
+      // Index of the first event, of the first LEPTO listing and of the LEPTO rows : counts of all the previous chunks
+      Long64_t first_event = 0, first_listing = 0, first_index = 0;
+      {
+	std::unique_lock<std::mutex> lock(count_mutex);
+	n_events[i]    = countEvents(particles);
+	n_listings[i]  = event_starts.size();
+	n_electrons[i] = (opt.input == "lepto") ? countLeptoElectrons(particles) : 0;
+	count_ready.notify_all();
+	for(int j = 0 ; j < i ; j++){
+	  count_ready.wait(lock, [&](){return n_events[j] >= 0;});
+	  first_event   += n_events[j];
+	  first_listing += n_listings[j];
+	  first_index   += n_electrons[j];
+	}
+      }
+      if(first_index > 0){
+	for(ThrownParticle& p : particles) p.event_index += first_index;
+      }
+      if(opt.sample_vertex) sampleVertices(vertex, first_listing, particles, event_starts);
+
+      // LUND text of the chunk, appended to the LUND file in chunk order
+      char*      lund_text = 0;
+      size_t     lund_size = 0;
+      EventIndex chunk_index(kIndexLund);
+      if(lund_file){
+	StageTimer lund_timer(local, kStageWrite);
+	FILE* lund_stream = open_memstream(&lund_text, &lund_size);
+	LundWriter lund(lund_stream, opt.beam_energy, opt.beam_energy_text);
+	if(opt.index) lund.setIndex(&chunk_index);
+	writeLundEvents(lund, particles, event_starts, n_finals);
+	std::fclose(lund_stream);
+      }
+
+      auto f = merger.GetFile();
+      f->cd();
+      ThrownOutput* output = bookThrownOutput(opt, 0, histograms[thread], cuts);
+      output->setFirstEvent(first_event);
+      output->setReport(local);
+      {
+	ThrownFiller<Run> filler(output, run, opt.kinematics, cuts);
+	fillFromParticles(particles, filler);
+      }
+      // The last event of the chunk (event schema) is filled before the buffer is written
+      output->flush();
+      delete output;
+
+      // Wait for the previous chunks to be queued, then queue this one
+      std::unique_lock<std::mutex> lock(write_mutex);
+      write_turn.wait(lock, [&](){return next_to_write == i;});
+      StageTimer write_timer(local, kStageWrite);
+      f->Write();
+      if(lund_file){
+	std::fwrite(lund_text, 1, lund_size, lund_file);
+	lund_index.append(chunk_index, lund_bytes);
+	lund_bytes += lund_size;
+      }
+      if(binary)    writeBinaryEvents(*binary, particles, event_starts);
+      write_timer.stop();
+      next_to_write++;
+      lock.unlock();
+      write_turn.notify_all();
+
+      std::free(lund_text);
+      if(report) report->merge(chunk_report);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for(int i = 0 ; i < n_threads ; i++) pool.emplace_back(worker, i);
+  for(std::thread& thread : pool) thread.join();
+
+  StageTimer close_timer(report, kStageWrite);
+  if(histograms[0]){
+    // Reduction of the histograms of the threads, written in one more buffer of the merger
+    for(int i = 1 ; i < n_threads ; i++) histograms[0]->add(*histograms[i]);
+    auto f = merger.GetFile();
+    f->cd();
+    histograms[0]->write();
+    f->Write();
+  }
+  for(HistogramSet* h : histograms) delete h;
+  bool lund_failed = lund_file && closeOutputFile(lund_file, opt.lund_out) != 0;
+  if(lund_failed) std::cout<<"Could not write "<<opt.lund_out<<std::endl;
+  if(lund_file && !lund_failed && opt.index && !lund_index.write(getIndexName(opt.lund_out), opt.lund_out)){
+    std::cout<<"Could not write "<<getIndexName(opt.lund_out)<<", build it with event_index"<<std::endl;
+  }
+  bool binary_failed = binary && !binary->close();
+  if(binary_failed) std::cout<<"Could not write "<<opt.binary_out<<std::endl;
+  delete binary;
+  close_timer.stop();
+
+  if(failed){
+    std::cout<<"Could not read "<<opt.file_in<<std::endl;
+    return 1;
+  }
+  if(lund_failed || binary_failed) return 1;
+
+  std::cout<<"Converted "<<chunks.size()<<" chunks with "<<n_threads<<" threads"<<std::endl;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,72 @@
+// Input from a pipe : stdin ("-") or a FIFO, so dat2tuple runs next to LEPTO
+//   lepto.exe < lepto.in | ./dat2tuple - out.root
+//   mkfifo lepto.fifo ; lepto.exe < lepto.in > lepto.fifo & ./dat2tuple lepto.fifo out.root
+// A FIFO is moved to stdin, so both are read through std::cin. The events are converted as they arrive
+// (streaming mode, the output is written while converting) and the text never touches the disk.
+// Without --input the format is guessed from the first character : .dat rows start with a number.
+// Compressed input files (compressed_io.h) are read the same way, from the stream of their decompressed text.
+
+// author : Esteban Molina
+
+#ifndef PIPE_INPUT_H
+#define PIPE_INPUT_H
+
+#include "options.h"
+#include "compressed_io.h"
+
+#include <cctype>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+std::string detectPipeFormat(std::istream& in){
+  // Waits for the first character that is not a space : .dat rows start with a number, LEPTO output with text.
+  // The spaces skipped are ignored by both parsers
+  in >> std::ws;
+  int c = in.peek();
+  return (std::isdigit(c) || c == '-' || c == '+') ? "dat" : "lepto";
+}
+
+bool openPipeInput(Options& opt){
+  // Reads the pipe through std::cin and sets the options it needs. Returns false if it can not be used
+  if(opt.threads > 1 || opt.merge || opt.reader == "fast" || opt.input == "binary"){
+    std::cout<<"Pipes are read once from the start : no --threads, --merge, --reader=fast or --input=binary"<<std::endl;
+    return false;
+  }
+
+  if(opt.file_in != "-"){
+    int fd = open(opt.file_in.c_str(), O_RDONLY);
+    if(fd < 0 || dup2(fd, STDIN_FILENO) < 0){
+      std::cout<<"Could not open "<<opt.file_in<<std::endl;
+      return false;
+    }
+    close(fd);
+  }
+  // std::cin with its own buffer, not character by character through stdio
+  std::ios::sync_with_stdio(false);
+
+  if(!opt.input_set) opt.input = detectPipeFormat(std::cin);
+  if((!opt.lund_out.empty() || opt.sample_vertex) && opt.input != "lepto"){
+    std::cout<<"--lund, --lD2_length and --z_range need the raw LEPTO output, the pipe has .dat rows"<<std::endl;
+    return false;
+  }
+  opt.stream = true;
+  return true;
+}
+
+bool openCompressedInput(Options& opt){
+  // Compressed inputs are read once from the start, as pipes. Returns false if they can not be used
+  if(opt.threads > 1 || opt.merge || opt.reader == "fast" || opt.input == "binary" || opt.shards > 1){
+    std::cout<<"Compressed inputs are read once from the start : no --threads, --merge, --shards, --reader=fast or --input=binary"<<std::endl;
+    return false;
+  }
+  opt.stream = true;
+  return true;
+}
+
+#endif
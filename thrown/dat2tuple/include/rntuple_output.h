@@ -0,0 +1,130 @@
+// RNTuple backend of the thrown output (--backend=rntuple)
+// Same logical columns as the typed schema of thrown_output.h : ntuple_thrown (hadrons), ntuple_thrown_electrons
+// and, with --raw, ntuple_thrown_raw, written as RNTuples in the output file so they can be read with RDataFrame.
+// Kinematics are float or double (--precision), event indices std::int64_t and PDG codes std::int32_t.
+
+// author : Esteban Molina
+
+#ifndef RNTUPLE_OUTPUT_H
+#define RNTUPLE_OUTPUT_H
+
+#include "thrown_output.h"
+#include "TFile.h"
+#include "RVersion.h"
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+#include <ROOT/RNTupleWriteOptions.hxx>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// RNTuple left ROOT::Experimental in 6.36
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,36,0)
+namespace rntuple = ROOT;
+#else
+namespace rntuple = ROOT::Experimental;
+#endif
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+template<class Real>
+class RNTupleOutput : public ThrownOutput{
+  std::unique_ptr<rntuple::RNTupleWriter> hadron_writer, electron_writer, raw_writer;
+
+  std::shared_ptr<std::int64_t> event_h, event_el, event_raw;
+  std::shared_ptr<std::int32_t> pid, raw_PID, raw_parent_PID;
+  std::shared_ptr<Real>         vars_h[kNvarsHadron];
+  std::shared_ptr<Real>         vars_el[kNvarsElectron];
+  std::shared_ptr<Real>         vars_raw[kNvarsRaw];
+
+public:
+  // Appends the RNTuples to file. compression < 0 keeps the RNTuple default
+  RNTupleOutput(TFile& file, int compression, bool write_raw);
+  ~RNTupleOutput();
+
+  void fillHadron(Long64_t event, double PID, const double* vars);
+  void fillElectron(Long64_t event, const double* vars);
+  void fillRaw(Long64_t event_index, double PID, double parent_PID, const double* vars);
+
+  // Commits the RNTuples, they are written on the file when it is closed
+  void write();
+};
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+template<class Real>
+RNTupleOutput<Real>::RNTupleOutput(TFile& file, int compression, bool write_raw) : ThrownOutput(true, sizeof(Real) == sizeof(double)){
+  // Class constructor
+  rntuple::RNTupleWriteOptions options;
+  if(compression >= 0) options.SetCompression(compression);
+
+  auto model_el = rntuple::RNTupleModel::Create();
+  event_el = model_el->MakeField<std::int64_t>("event");
+  for(int i = 0 ; i < kNvarsElectron ; i++) vars_el[i] = model_el->MakeField<Real>(kElectronBranches[i]);
+  electron_writer = rntuple::RNTupleWriter::Append(std::move(model_el), "ntuple_thrown_electrons", file, options);
+
+  auto model_h = rntuple::RNTupleModel::Create();
+  event_h = model_h->MakeField<std::int64_t>("event");
+  for(int i = 0 ; i < kNvarsHadron ; i++) vars_h[i] = model_h->MakeField<Real>(kHadronBranches[i]);
+  pid = model_h->MakeField<std::int32_t>("pid");
+  hadron_writer = rntuple::RNTupleWriter::Append(std::move(model_h), "ntuple_thrown", file, options);
+
+  with_raw = write_raw;
+  if(write_raw){
+    auto model_raw = rntuple::RNTupleModel::Create();
+    event_raw      = model_raw->MakeField<std::int64_t>("event_index");
+    for(int i = 0 ; i < kNvarsRaw ; i++) vars_raw[i] = model_raw->MakeField<Real>(kRawBranches[i]);
+    raw_PID        = model_raw->MakeField<std::int32_t>("PID");
+    raw_parent_PID = model_raw->MakeField<std::int32_t>("parent_PID");
+    raw_writer = rntuple::RNTupleWriter::Append(std::move(model_raw), "ntuple_thrown_raw", file, options);
+  }
+}
+
+template<class Real>
+RNTupleOutput<Real>::~RNTupleOutput(){
+  write();
+}
+
+template<class Real>
+void RNTupleOutput<Real>::fillHadron(Long64_t event, double PID, const double* vars){
+  // Cluster commits happen inside Fill, the report can not tell them apart
+  FillTimer timer(report, 0);
+  *event_h = event;
+  *pid     = (std::int32_t) PID;
+  for(int i = 0 ; i < kNvarsHadron ; i++) *vars_h[i] = (Real) vars[i];
+  hadron_writer->Fill();
+}
+
+template<class Real>
+void RNTupleOutput<Real>::fillElectron(Long64_t event, const double* vars){
+  FillTimer timer(report, 0);
+  *event_el = event;
+  for(int i = 0 ; i < kNvarsElectron ; i++) *vars_el[i] = (Real) vars[i];
+  electron_writer->Fill();
+}
+
+template<class Real>
+void RNTupleOutput<Real>::fillRaw(Long64_t event_index, double PID, double parent_PID, const double* vars){
+  if(!raw_writer) return;
+  FillTimer timer(report, 0);
+  *event_raw      = event_index;
+  *raw_PID        = (std::int32_t) PID;
+  *raw_parent_PID = (std::int32_t) parent_PID;
+  for(int i = 0 ; i < kNvarsRaw ; i++) *vars_raw[i] = (Real) vars[i];
+  raw_writer->Fill();
+}
+
+template<class Real>
+void RNTupleOutput<Real>::write(){
+  // Destroying the writers commits the clusters still in memory and the RNTuple anchors
+  hadron_writer.reset();
+  electron_writer.reset();
+  raw_writer.reset();
+}
+
+#endif
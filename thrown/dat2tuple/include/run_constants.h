@@ -0,0 +1,58 @@
+// Per-run constants of the conversion (beam energy, target mass, vertex)
+// RunConstants holds values chosen at run time. FixedRunConstants hardcodes the common beam
+// energies so the kinematics can be constant folded by the compiler.
+
+// author : Esteban Molina
+
+#ifndef RUN_CONSTANTS_H
+#define RUN_CONSTANTS_H
+
+#include "constants.h"
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class RunConstants{
+  double Ebeam, Mtarget, Zvertex;
+  // derived
+  double Mtarget2, TwoMtarget;
+
+public:
+  RunConstants(double Ebeam = kEbeam, double Mtarget = kMassProton, double Zvertex = 0.);
+  ~RunConstants();
+
+  double getEbeam()	const {return Ebeam;}
+  double getMtarget()	const {return Mtarget;}
+  double getMtarget2()	const {return Mtarget2;}
+  double get2Mtarget()	const {return TwoMtarget;}
+  double getZvertex()	const {return Zvertex;}
+};
+
+template<int EbeamGeV>
+class FixedRunConstants{
+  double Zvertex;
+
+public:
+  FixedRunConstants(double z = 0.) : Zvertex(z){}
+
+  double getEbeam()	const {return EbeamGeV;}
+  double getMtarget()	const {return kMassProton;}
+  double getMtarget2()	const {return kMassProton*kMassProton;}
+  double get2Mtarget()	const {return 2.*kMassProton;}
+  double getZvertex()	const {return Zvertex;}
+};
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+RunConstants::RunConstants(double E, double M, double z) : Ebeam(E), Mtarget(M), Zvertex(z){
+  // Class constructor. Derived constants are computed once per run
+  Mtarget2   = Mtarget*Mtarget;
+  TwoMtarget = 2.*Mtarget;
+}
+
+RunConstants::~RunConstants(){}
+
+#endif
@@ -0,0 +1,507 @@
+// Selection applied while converting (--select="<expression>"), so only the rows the analyses keep are written
+//   Q2>1 && W>2 && y<0.85 && zh>0.1 && (pid==211 || pid==-211)
+//   variables : typed hadron branch names (kHadronBranches of thrown_output.h), pid and vz, in any case (zh = Zh)
+//   operators : || && ! == != < <= > >= + - * /, parentheses and the functions abs() and sqrt()
+// The expression is compiled once into postfix programs, one per term of the top-level &&, and every term is
+// evaluated as soon as its variables are known :
+//   leptonic terms (Q2, Xb, Nu, W, y, *_el, vz) : once per event, on the scattered electron. The fillers skip the
+//                                                 events that fail before computing any hadronic variable
+//   pid terms                                   : on every row, before its kinematics
+//   hadronic terms                              : on every hadron row, after its kinematics (SelectionOutput)
+// An expression with a top-level || is a single term. The raw records (--raw) keep every input row.
+
+// author : Esteban Molina
+
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include "thrown_output.h"
+#include "job_report.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+enum SelectionStage{kSelectLeptonic, kSelectPid, kSelectHadronic, kNselectStages};
+
+enum SelectionOpCode{kOpValue, kOpSlot, kOpNeg, kOpNot, kOpAbs, kOpSqrt, kOpAdd, kOpSub, kOpMul, kOpDiv,
+		     kOpLt, kOpLe, kOpGt, kOpGe, kOpEq, kOpNe, kOpAnd, kOpOr};
+
+// Values seen by the programs : the hadron columns, pid and the vertex of the event
+const int kSlotPid         = kNvarsHadron;
+const int kSlotVz          = kNvarsHadron + 1;
+const int kNselectSlots    = kNvarsHadron + 2;
+const int kMaxSelectDepth  = 64;	// stack of the programs
+
+// Slots of the electron columns (kElectronBranches)
+const int kElectronSlots[kNvarsElectron] = {0, 1, 2, 3, 4, 16, 17, 18, 19, 20, 21, kSlotVz};
+
+//####################################################################################################################//
+//########################################        DATA RECORDS           #############################################//
+//####################################################################################################################//
+
+struct SelectionOp{
+  SelectionOpCode code;
+  int             slot;
+  double          value;
+};
+
+struct SelectionTerm{
+  std::string              text;
+  std::vector<SelectionOp> program;
+};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+// Recursive descent parser of one term, writes the postfix program
+class SelectionParser{
+  const std::vector<std::string>& tokens;
+  size_t                          pos, end;
+  std::vector<SelectionOp>&       program;
+  unsigned long long&             slots;	// bit mask of the slots used
+  int                             depth, max_depth;
+  std::string                     error;
+
+  void emit(SelectionOpCode code, int slot = -1, double value = 0.);
+  bool accept(const char* token);
+  bool parseOr();
+  bool parseAnd();
+  bool parseComparison();
+  bool parseSum();
+  bool parseProduct();
+  bool parseUnary();
+  bool parsePrimary();
+
+public:
+  SelectionParser(const std::vector<std::string>& tokens, size_t begin, size_t end, std::vector<SelectionOp>& program, unsigned long long& slots);
+  ~SelectionParser();
+
+  bool        parse();
+  std::string getError()	{return error;}
+};
+
+class Selection{
+  std::vector<SelectionTerm> terms[kNselectStages];
+
+  bool evaluate(const std::vector<SelectionOp>& program, const double* slots) const;
+  bool pass(SelectionStage stage, const double* slots) const;
+
+public:
+  Selection();
+  ~Selection();
+
+  // Compiles the expression, returns false after printing the error if it is wrong
+  bool compile(const std::string& expression);
+
+  bool hasTerms(SelectionStage stage) const	{return !terms[stage].empty();}
+
+  // vars in the order of kElectronBranches/kHadronBranches
+  bool passElectron(const double* vars) const;
+  bool passPid(double PID) const;
+  bool passHadron(double PID, const double* vars, double vz) const;
+};
+
+// Writes to the next output only the hadron rows that pass the hadronic terms
+class SelectionOutput : public ThrownOutput{
+  const Selection& selection;
+  ThrownOutput*    next;	// owned
+  double           vz;		// vertex of the current event
+
+public:
+  SelectionOutput(const Selection& selection, ThrownOutput* next);
+  ~SelectionOutput();
+
+  void setReport(JobReport* r);
+
+  void fillHadron(Long64_t event, double PID, const double* vars);
+  void fillElectron(Long64_t event, const double* vars);
+  void fillRaw(Long64_t event_index, double PID, double parent_PID, const double* vars);
+  void flush();
+  void write();
+};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+bool tokenizeSelection(const std::string& expression, std::vector<std::string>& tokens){
+  // Numbers, names and operators. Returns false on an unknown character
+  const char* const operators[] = {"||", "&&", "==", "!=", "<=", ">=", "<", ">", "!", "+", "-", "*", "/", "(", ")"};
+  size_t i = 0;
+  while(i < expression.size()){
+    char c = expression[i];
+    if(std::isspace((unsigned char) c)){
+      i++;
+      continue;
+    }
+    if(std::isdigit((unsigned char) c) || c == '.'){
+      char* end = 0;
+      std::strtod(expression.c_str() + i, &end);
+      size_t n = end - (expression.c_str() + i);
+      if(n == 0) return false;
+      tokens.push_back(expression.substr(i, n));
+      i += n;
+      continue;
+    }
+    if(std::isalpha((unsigned char) c) || c == '_'){
+      size_t n = 1;
+      while(i + n < expression.size() && (std::isalnum((unsigned char) expression[i + n]) || expression[i + n] == '_')) n++;
+      tokens.push_back(expression.substr(i, n));
+      i += n;
+      continue;
+    }
+    bool found = false;
+    for(const char* op : operators){
+      size_t n = std::char_traits<char>::length(op);
+      if(expression.compare(i, n, op) == 0){
+	tokens.push_back(op);
+	i += n;
+	found = true;
+	break;
+      }
+    }
+    if(!found) return false;
+  }
+  return true;
+}
+
+int getSelectionSlot(const std::string& name){
+  // Slot of a variable name, without case. -1 if unknown
+  auto same = [&](const char* other){
+    size_t n = std::char_traits<char>::length(other);
+    if(n != name.size()) return false;
+    for(size_t i = 0 ; i < n ; i++){
+      if(std::tolower((unsigned char) name[i]) != std::tolower((unsigned char) other[i])) return false;
+    }
+    return true;
+  };
+  for(int i = 0 ; i < kNvarsHadron ; i++){
+    if(same(kHadronBranches[i])) return i;
+  }
+  if(same("pid")) return kSlotPid;
+  if(same("vz"))  return kSlotVz;
+  return -1;
+}
+
+SelectionStage getSelectionStage(unsigned long long slots){
+  // Earliest stage where all the slots of a term are known
+  unsigned long long leptonic = 1ULL<<kSlotVz;
+  for(int i = 0 ; i < kNvarsElectron ; i++) leptonic |= 1ULL<<kElectronSlots[i];
+  if(slots == (1ULL<<kSlotPid))         return kSelectPid;
+  if(slots && (slots & ~leptonic) == 0) return kSelectLeptonic;
+  return kSelectHadronic;
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+SelectionParser::SelectionParser(const std::vector<std::string>& t, size_t begin, size_t e, std::vector<SelectionOp>& p, unsigned long long& s) :
+  tokens(t), pos(begin), end(e), program(p), slots(s), depth(0), max_depth(0){}
+
+SelectionParser::~SelectionParser(){}
+
+void SelectionParser::emit(SelectionOpCode code, int slot, double value){
+  program.push_back({code, slot, value});
+  // Values push, unary operators keep the depth and binary operators pop one
+  if(code == kOpValue || code == kOpSlot) depth++;
+  else if(code >= kOpAdd)                 depth--;
+  if(depth > max_depth) max_depth = depth;
+}
+
+bool SelectionParser::accept(const char* token){
+  if(pos < end && tokens[pos] == token){
+    pos++;
+    return true;
+  }
+  return false;
+}
+
+bool SelectionParser::parse(){
+  if(!parseOr()) return false;
+  if(pos != end){
+    error = "unexpected " + tokens[pos];
+    return false;
+  }
+  if(max_depth > kMaxSelectDepth){
+    error = "expression too long";
+    return false;
+  }
+  return true;
+}
+
+bool SelectionParser::parseOr(){
+  if(!parseAnd()) return false;
+  while(accept("||")){
+    if(!parseAnd()) return false;
+    emit(kOpOr);
+  }
+  return true;
+}
+
+bool SelectionParser::parseAnd(){
+  if(!parseComparison()) return false;
+  while(accept("&&")){
+    if(!parseComparison()) return false;
+    emit(kOpAnd);
+  }
+  return true;
+}
+
+bool SelectionParser::parseComparison(){
+  if(!parseSum()) return false;
+  const char*           ops[6]   = {"<", "<=", ">", ">=", "==", "!="};
+  const SelectionOpCode codes[6] = {kOpLt, kOpLe, kOpGt, kOpGe, kOpEq, kOpNe};
+  for(int i = 0 ; i < 6 ; i++){
+    if(accept(ops[i])){
+      if(!parseSum()) return false;
+      emit(codes[i]);
+      return true;
+    }
+  }
+  return true;
+}
+
+bool SelectionParser::parseSum(){
+  if(!parseProduct()) return false;
+  while(true){
+    if(accept("+")){
+      if(!parseProduct()) return false;
+      emit(kOpAdd);
+    }
+    else if(accept("-")){
+      if(!parseProduct()) return false;
+      emit(kOpSub);
+    }
+    else return true;
+  }
+}
+
+bool SelectionParser::parseProduct(){
+  if(!parseUnary()) return false;
+  while(true){
+    if(accept("*")){
+      if(!parseUnary()) return false;
+      emit(kOpMul);
+    }
+    else if(accept("/")){
+      if(!parseUnary()) return false;
+      emit(kOpDiv);
+    }
+    else return true;
+  }
+}
+
+bool SelectionParser::parseUnary(){
+  if(accept("-")){
+    if(!parseUnary()) return false;
+    emit(kOpNeg);
+    return true;
+  }
+  if(accept("!")){
+    if(!parseUnary()) return false;
+    emit(kOpNot);
+    return true;
+  }
+  return parsePrimary();
+}
+
+bool SelectionParser::parsePrimary(){
+  if(pos >= end){
+    error = "unexpected end";
+    return false;
+  }
+  const std::string& token = tokens[pos++];
+
+  if(token == "("){
+    if(!parseOr()) return false;
+    if(!accept(")")){
+      error = "missing )";
+      return false;
+    }
+    return true;
+  }
+  if(std::isdigit((unsigned char) token[0]) || token[0] == '.'){
+    emit(kOpValue, -1, std::strtod(token.c_str(), 0));
+    return true;
+  }
+  if(std::isalpha((unsigned char) token[0]) || token[0] == '_'){
+    if(token == "abs" || token == "sqrt"){
+      if(!accept("(") || !parseOr() || !accept(")")){
+	if(error.empty()) error = token + " needs (<expression>)";
+	return false;
+      }
+      emit(token == "abs" ? kOpAbs : kOpSqrt);
+      return true;
+    }
+    int slot = getSelectionSlot(token);
+    if(slot < 0){
+      error = "unknown variable " + token;
+      return false;
+    }
+    slots |= 1ULL<<slot;
+    emit(kOpSlot, slot);
+    return true;
+  }
+
+  error = "unexpected " + token;
+  return false;
+}
+
+Selection::Selection(){}
+
+Selection::~Selection(){}
+
+bool Selection::compile(const std::string& expression){
+  std::vector<std::string> tokens;
+  if(!tokenizeSelection(expression, tokens) || tokens.empty()){
+    std::cout<<"Wrong selection "<<expression<<std::endl;
+    return false;
+  }
+
+  // Terms of the top-level &&, unless there is a top-level || (then the expression is a single term)
+  std::vector<size_t> bounds = {0};
+  int  level     = 0;
+  bool top_or    = false;
+  for(size_t i = 0 ; i < tokens.size() ; i++){
+    if(tokens[i] == "(")                    level++;
+    else if(tokens[i] == ")")               level--;
+    else if(level == 0 && tokens[i] == "||") top_or = true;
+    else if(level == 0 && tokens[i] == "&&") bounds.push_back(i + 1);
+  }
+  if(top_or) bounds.resize(1);
+  bounds.push_back(tokens.size() + 1);
+
+  for(size_t i = 0 ; i + 1 < bounds.size() ; i++){
+    SelectionTerm      term;
+    unsigned long long slots = 0;
+    size_t             begin = bounds[i], end = bounds[i + 1] - 1;
+    for(size_t j = begin ; j < end ; j++) term.text += (j > begin ? " " : "") + tokens[j];
+
+    SelectionParser parser(tokens, begin, end, term.program, slots);
+    if(!parser.parse()){
+      std::cout<<"Wrong selection "<<expression<<" : "<<parser.getError()<<std::endl;
+      return false;
+    }
+    terms[getSelectionStage(slots)].push_back(term);
+  }
+  return true;
+}
+
+bool Selection::evaluate(const std::vector<SelectionOp>& program, const double* slots) const{
+  double stack[kMaxSelectDepth];
+  int    n = 0;
+  for(const SelectionOp& op : program){
+    switch(op.code){
+    case kOpValue : stack[n++] = op.value;              break;
+    case kOpSlot  : stack[n++] = slots[op.slot];        break;
+    case kOpNeg   : stack[n-1] = -stack[n-1];           break;
+    case kOpNot   : stack[n-1] = (stack[n-1] == 0.);    break;
+    case kOpAbs   : stack[n-1] = std::fabs(stack[n-1]); break;
+    case kOpSqrt  : stack[n-1] = std::sqrt(stack[n-1]); break;
+    default :
+      double b = stack[--n];
+      double a = stack[n-1];
+      double r = 0.;
+      switch(op.code){
+      case kOpAdd : r = a + b;                  break;
+      case kOpSub : r = a - b;                  break;
+      case kOpMul : r = a * b;                  break;
+      case kOpDiv : r = a / b;                  break;
+      case kOpLt  : r = a <  b;                 break;
+      case kOpLe  : r = a <= b;                 break;
+      case kOpGt  : r = a >  b;                 break;
+      case kOpGe  : r = a >= b;                 break;
+      case kOpEq  : r = a == b;                 break;
+      case kOpNe  : r = a != b;                 break;
+      case kOpAnd : r = (a != 0.) && (b != 0.); break;
+      case kOpOr  : r = (a != 0.) || (b != 0.); break;
+      default     :                             break;
+      }
+      stack[n-1] = r;
+    }
+  }
+  return n == 1 && stack[0] != 0.;
+}
+
+bool Selection::pass(SelectionStage stage, const double* slots) const{
+  for(const SelectionTerm& term : terms[stage]){
+    if(!evaluate(term.program, slots)) return false;
+  }
+  return true;
+}
+
+bool Selection::passElectron(const double* vars) const{
+  if(terms[kSelectLeptonic].empty()) return true;
+  double slots[kNselectSlots] = {};
+  for(int i = 0 ; i < kNvarsElectron ; i++) slots[kElectronSlots[i]] = vars[i];
+  return pass(kSelectLeptonic, slots);
+}
+
+bool Selection::passPid(double PID) const{
+  if(terms[kSelectPid].empty()) return true;
+  double slots[kNselectSlots] = {};
+  slots[kSlotPid] = PID;
+  return pass(kSelectPid, slots);
+}
+
+bool Selection::passHadron(double PID, const double* vars, double vz) const{
+  if(terms[kSelectHadronic].empty()) return true;
+  double slots[kNselectSlots];
+  for(int i = 0 ; i < kNvarsHadron ; i++) slots[i] = vars[i];
+  slots[kSlotPid] = PID;
+  slots[kSlotVz]  = vz;
+  return pass(kSelectHadronic, slots);
+}
+
+SelectionOutput::SelectionOutput(const Selection& s, ThrownOutput* n) : ThrownOutput(false, false), selection(s), next(n), vz(0.){
+  // Class constructor
+  // The trees of the next output, so the conversion handles them as without selection
+  hadrons     = next->getHadronTree();
+  electrons   = next->getElectronTree();
+  raw         = next->getRawTree();
+  events      = next->getEventTree();
+  with_raw    = next->hasRaw();
+  first_event = next->getFirstEvent();
+}
+
+SelectionOutput::~SelectionOutput(){
+  delete next;
+}
+
+void SelectionOutput::setReport(JobReport* r){
+  report = r;
+  next->setReport(r);
+}
+
+void SelectionOutput::fillHadron(Long64_t event, double PID, const double* vars){
+  if(!selection.passHadron(PID, vars, vz)){
+    if(report) report->countRejected(false);
+    return;
+  }
+  next->fillHadron(event, PID, vars);
+}
+
+void SelectionOutput::fillElectron(Long64_t event, const double* vars){
+  vz = vars[kNvarsElectron - 1];
+  next->fillElectron(event, vars);
+}
+
+void SelectionOutput::fillRaw(Long64_t event_index, double PID, double parent_PID, const double* vars){
+  next->fillRaw(event_index, PID, parent_PID, vars);
+}
+
+void SelectionOutput::flush(){
+  next->flush();
+}
+
+void SelectionOutput::write(){
+  next->write();
+}
+
+#endif
@@ -0,0 +1,372 @@
+// Fills the thrown ntuples row by row with the kinematics implementation chosen with --kinematics
+//   reference : fillThrown (LeptonicKinematics per event, HadronicKinematics per row)
+//   fused     : FusedFiller (virtual photon frame once per event)
+//   batch     : BatchFiller (vectorized blocks)
+// With a job report on the output, the rows are counted and the fill functions time the read and kinematics stages.
+// With a selection, the events that fail the leptonic terms and the rows that fail the pid terms are dropped here,
+// before their hadronic kinematics (selection.h).
+// With a vertex sampler, the LEPTO events get their z vertex from it before being written or filled (vertex_sampler.h).
+
+// author : Esteban Molina
+
+#ifndef THROWN_FILLER_H
+#define THROWN_FILLER_H
+
+#include "dat2tuple.h"
+#include "hadron_frame.h"
+#include "lepto_parser.h"
+#include "lund_writer.h"
+#include "dat_reader.h"
+#include "fast_dat_reader.h"
+#include "binary_format.h"
+#include "thrown_output.h"
+#include "event_output.h"
+#include "rntuple_output.h"
+#include "histogram_output.h"
+#include "selection.h"
+#include "vertex_sampler.h"
+#include "options.h"
+#include "job_report.h"
+#include "TFile.h"
+#include "TROOT.h"
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+// Output ROOT file closed and deleted on every return, so a failed conversion leaves no open file behind
+// (closed at exit, it would be written over the output of the next attempt)
+struct OutputFileCloser{
+  void operator()(TFile* f) const	{f->Close(); gROOT->cd(); delete f;}
+};
+typedef std::unique_ptr<TFile, OutputFileCloser> OutputFile;
+
+template<class Run>
+class ThrownFiller{
+  ThrownOutput*           output;
+  const Run&              run;
+  LeptonicKinematics<Run> lk;
+  Long64_t                event;
+  BatchFiller<Run>*       batch;
+  FusedFiller<Run>*       fused;
+  JobReport*              report;
+  const Selection*        selection;
+  bool                    rejected;	// the current event failed the leptonic terms
+
+  // Applies the leptonic and pid terms, returns false if the row is dropped
+  bool select(double PID, double parent_PID, double Px, double Py, double Pz, double z);
+
+public:
+  ThrownFiller(ThrownOutput* output, const Run& run, const std::string& kinematics, const Selection* selection = 0);
+  ~ThrownFiller();
+
+  void fill(double PID, double parent_PID, double Px, double Py, double Pz, double z);
+  // Full row of the input, also written to the raw records when they are on
+  void fill(const ThrownParticle& p);
+  // Fills the rows still buffered (batch kinematics)
+  void flush();
+
+  JobReport* getReport()	{return report;}
+};
+
+// Rows of the tree made by TTree::ReadFile (legacy reader), with the interface of DatReader
+class TreeRowReader{
+  TTree*   t;
+  Long64_t entry, n_entries;
+  Double_t event_index, PID, parent_PID, Px, Py, Pz, E, x, y, z;
+
+public:
+  TreeRowReader(TTree* tree);
+  ~TreeRowReader();
+
+  bool nextRow(ThrownParticle& p);
+};
+
+// Rows read at once by fillFromRows, so reading and filling are timed by blocks and not by rows
+const size_t kRowBlock = 4096;
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+template<class Run>
+ThrownFiller<Run>::ThrownFiller(ThrownOutput* out, const Run& r, const std::string& kinematics, const Selection* s) :
+  output(out), run(r), lk(0., 0., 0., r), event(out->getFirstEvent() - 1), batch(0), fused(0), report(out->getReport()),
+  selection(s), rejected(false){
+  // Class constructor
+  if(kinematics == "batch")      batch = new BatchFiller<Run>(out, r);
+  else if(kinematics == "fused") fused = new FusedFiller<Run>(out, r);
+}
+
+template<class Run>
+ThrownFiller<Run>::~ThrownFiller(){
+  flush();
+  delete batch;
+  delete fused;
+}
+
+template<class Run>
+void ThrownFiller<Run>::fill(double PID, double parent_PID, double Px, double Py, double Pz, double z){
+  if(report) report->countRow((int) PID, (int) parent_PID);
+  if(selection && !select(PID, parent_PID, Px, Py, Pz, z)) return;
+  if(batch)      batch->fill(PID, parent_PID, Px, Py, Pz, z);
+  else if(fused) fused->fill(PID, parent_PID, Px, Py, Pz, z);
+  else           fillThrown(output, lk, event, run, PID, parent_PID, Px, Py, Pz, z);
+}
+
+template<class Run>
+bool ThrownFiller<Run>::select(double PID, double parent_PID, double Px, double Py, double Pz, double z){
+  if(PID==11 && parent_PID==0){
+    if(!selection->hasTerms(kSelectLeptonic)) return true;
+    LeptonicKinematics<Run> el(Px,Py,Pz,run);
+    double vars_el[kNvarsElectron] = {el.getQ2(), el.getXb(), el.getNu(), el.getW(), el.gety(), el.getThetaLab_el(), el.getPhiLab_el(), el.getP_el(), Px, Py, Pz, z};
+    rejected = !selection->passElectron(vars_el);
+    if(!rejected) return true;
+    // The event keeps its index
+    if(report)     report->countRejected(true);
+    if(batch)      batch->skipEvent();
+    else if(fused) fused->skipEvent();
+    else           event++;
+    return false;
+  }
+  if(rejected) return false;
+  if(PID != 11 && PID != 22 && PID !=-11 && !selection->passPid(PID)){
+    if(report) report->countRejected(false);
+    return false;
+  }
+  return true;
+}
+
+template<class Run>
+void ThrownFiller<Run>::fill(const ThrownParticle& p){
+  if(output->hasRaw()){
+    double vars_raw[kNvarsRaw] = {p.Px, p.Py, p.Pz, p.E, p.x, p.y, p.z};
+    output->fillRaw(p.event_index, p.PID, p.parent_PID, vars_raw);
+  }
+  fill(p.PID, p.parent_PID, p.Px, p.Py, p.Pz, p.z);
+}
+
+template<class Run>
+void ThrownFiller<Run>::flush(){
+  if(batch) batch->flush();
+}
+
+TreeRowReader::TreeRowReader(TTree* tree) : t(tree), entry(0), n_entries(tree->GetEntries()){
+  // Class constructor
+  setBranchesAddresses(t, &event_index, &PID, &parent_PID, &Px, &Py, &Pz, &E, &x, &y, &z);
+}
+
+TreeRowReader::~TreeRowReader(){}
+
+bool TreeRowReader::nextRow(ThrownParticle& p){
+  if(entry >= n_entries) return false;
+  t->GetEntry(entry++);
+  p = {(int) event_index, (int) PID, (int) parent_PID, Px, Py, Pz, E, x, y, z};
+  return true;
+}
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+int getCompressionSettings(const Options& opt);
+
+ThrownOutput* bookThrownOutput(const Options& opt, TFile* file = 0, HistogramSet* histograms = 0, const Selection* selection = 0){
+  // Creates the output with the backend, schema and tree settings of the options
+  // TTree backend : trees in the current directory. RNTuple backend : RNTuples appended to file
+  // With histograms, the rows also fill them (and only them with --no_ntuples)
+  // With hadronic terms in the selection, only the hadrons that pass reach the histograms and ntuples
+  if(selection && selection->hasTerms(kSelectHadronic)) return new SelectionOutput(*selection, bookThrownOutput(opt, file, histograms));
+  if(histograms) return new HistogramOutput(*histograms, opt.no_ntuples ? 0 : bookThrownOutput(opt, file));
+  if(opt.backend == "rntuple"){
+    int compression = opt.compression.empty() ? -1 : getCompressionSettings(opt);
+    if(opt.precision == "double") return new RNTupleOutput<double>(*file, compression, opt.raw);
+    return new RNTupleOutput<float>(*file, compression, opt.raw);
+  }
+
+  ThrownOutput* output = 0;
+  if(opt.schema == "event"){
+    if(opt.precision == "double") output = new EventOutput<double>(opt.basket_size, opt.raw);
+    else                          output = new EventOutput<float>(opt.basket_size, opt.raw);
+  }
+  else output = new ThrownOutput(opt.schema, opt.precision == "double", opt.basket_size, opt.raw);
+  if(opt.auto_flush != 0){
+    for(TTree* t : {output->getHadronTree(), output->getElectronTree(), output->getRawTree(), output->getEventTree()}){
+      if(t) t->SetAutoFlush(opt.auto_flush);
+    }
+  }
+  return output;
+}
+
+int getCompressionSettings(const Options& opt){
+  // ROOT compression settings (100*algorithm + level) of the options
+  // Without --compression : 101, the compiled default of TFile (ROOT::RCompressionSetting::EDefaults::kUseCompiledDefault)
+  if(opt.compression.empty()) return 101;
+  // Algorithm codes of ROOT::RCompressionSetting::EAlgorithm and their default levels
+  int algorithm = 1, level = 1;
+  if(opt.compression == "lzma")     {algorithm = 2; level = 7;}
+  else if(opt.compression == "lz4") {algorithm = 4; level = 4;}
+  else if(opt.compression == "zstd"){algorithm = 5; level = 5;}
+  if(opt.compression_level >= 0) level = opt.compression_level;
+  return 100*algorithm + level;
+}
+
+template<class Reader, class Run>
+void fillFromRows(Reader& reader, ThrownFiller<Run>& filler, BinaryEventWriter* binary = 0){
+  // Fills the ntuples with the rows of a .dat reader (DatReader, FastDatReader or TreeRowReader)
+  JobReport* report = filler.getReport();
+  std::vector<ThrownParticle> block(kRowBlock);
+  while(true){
+    StageTimer read_timer(report, kStageRead);
+    size_t n = 0;
+    while(n < kRowBlock && reader.nextRow(block[n])) n++;
+    read_timer.stop();
+    if(n == 0) break;
+
+    StageTimer fill_timer(report, kStageKinematics);
+    for(size_t i = 0 ; i < n ; i++){
+      if(binary) binary->addParticle(block[i]);
+      filler.fill(block[i]);
+    }
+  }
+  StageTimer fill_timer(report, kStageKinematics);
+  filler.flush();
+}
+
+void sampleVertex(const VertexSampler& vertex, long long listing, ThrownParticle* particles, size_t n){
+  // Stamps the z vertex of the event listing on its particles
+  double z = vertex.getZ(listing);
+  for(size_t i = 0 ; i < n ; i++) particles[i].z = z;
+}
+
+template<class Run>
+void fillFromStream(std::istream& in, const std::string& format, const Run& run, ThrownFiller<Run>& filler, LundWriter* lund,
+		    BinaryEventWriter* binary = 0, const VertexSampler* vertex = 0){
+  // Reads .dat rows or LEPTO event listings from in and fills the ntuples (and the LUND and binary files if given)
+  JobReport* report = filler.getReport();
+  if(format == "lepto"){
+    LeptoParser parser(in, run.getZvertex());
+    std::vector<ThrownParticle> particles;
+    for(long long listing = 0 ; ; listing++){
+      StageTimer read_timer(report, kStageRead);
+      if(!parser.nextEvent(particles)) break;
+      if(vertex) sampleVertex(*vertex, listing, particles.data(), particles.size());
+      read_timer.stop();
+
+      StageTimer write_timer(report, kStageWrite);
+      if(lund)   lund->writeEvent(particles, parser.getNfinal());
+      if(binary) binary->writeEvent(particles);
+      write_timer.stop();
+
+      StageTimer fill_timer(report, kStageKinematics);
+      for(const ThrownParticle& p : particles) filler.fill(p);
+    }
+  }
+  else{
+    DatReader reader(in);
+    fillFromRows(reader, filler, binary);
+  }
+  StageTimer fill_timer(report, kStageKinematics);
+  filler.flush();
+}
+
+template<class Run>
+void fillFromBinary(BinaryEventReader& reader, ThrownFiller<Run>& filler){
+  // Fills the ntuples with the records of a binary event file
+  // The records are read from the map while filling, their time goes to the kinematics
+  StageTimer fill_timer(filler.getReport(), kStageKinematics);
+  const BinaryParticle* end = reader.getParticles() + reader.getNparticles();
+  for(const BinaryParticle* b = reader.getParticles() ; b != end ; b++) filler.fill(toThrownParticle(*b));
+  filler.flush();
+}
+
+template<class Run>
+void fillFromParticles(const std::vector<ThrownParticle>& particles, ThrownFiller<Run>& filler){
+  // Fills the ntuples with particles already read
+  StageTimer fill_timer(filler.getReport(), kStageKinematics);
+  for(const ThrownParticle& p : particles) filler.fill(p);
+  filler.flush();
+}
+
+template<class Reader>
+void readRows(Reader& reader, std::vector<ThrownParticle>& particles){
+  // Reads all the rows of a .dat reader
+  ThrownParticle p;
+  while(reader.nextRow(p)) particles.push_back(p);
+}
+
+void readParticles(std::istream& in, const std::string& format, double z_vertex, std::vector<ThrownParticle>& particles,
+		   std::vector<size_t>* event_starts = 0, std::vector<int>* n_finals = 0){
+  // Reads all the .dat rows or LEPTO event listings of in
+  // event_starts gets the position of the first particle of every LEPTO event, n_finals the particle count of its LUND header
+  if(format == "lepto"){
+    LeptoParser parser(in, z_vertex);
+    std::vector<ThrownParticle> event;
+    while(parser.nextEvent(event)){
+      if(event_starts) event_starts->push_back(particles.size());
+      if(n_finals)     n_finals->push_back(parser.getNfinal());
+      particles.insert(particles.end(), event.begin(), event.end());
+    }
+  }
+  else{
+    DatReader reader(in);
+    readRows(reader, particles);
+  }
+}
+
+void writeBinaryEvents(BinaryEventWriter& binary, const std::vector<ThrownParticle>& particles, const std::vector<size_t>& event_starts){
+  // Writes particles read by readParticles. Without event_starts (.dat rows) the events follow event_index,
+  // the first particle always starts an event since chunks begin at an event boundary
+  if(event_starts.empty()){
+    if(!particles.empty()) binary.beginEvent();
+    for(const ThrownParticle& p : particles) binary.addParticle(p);
+    return;
+  }
+  for(size_t i = 0 ; i < event_starts.size() ; i++){
+    size_t end = (i + 1 < event_starts.size()) ? event_starts[i + 1] : particles.size();
+    binary.writeEvent(particles.data() + event_starts[i], end - event_starts[i]);
+  }
+}
+
+void writeLundEvents(LundWriter& lund, const std::vector<ThrownParticle>& particles, const std::vector<size_t>& event_starts,
+		     const std::vector<int>& n_finals){
+  // Writes the LEPTO events read by readParticles, once their vertices are set
+  for(size_t i = 0 ; i < event_starts.size() ; i++){
+    size_t end = (i + 1 < event_starts.size()) ? event_starts[i + 1] : particles.size();
+    lund.writeEvent(particles.data() + event_starts[i], end - event_starts[i], n_finals[i]);
+  }
+}
+
+void sampleVertices(const VertexSampler& vertex, long long first_listing, std::vector<ThrownParticle>& particles,
+		    const std::vector<size_t>& event_starts){
+  // Stamps the z vertex of every LEPTO event read by readParticles, first_listing being the number of the first one in the input
+  for(size_t i = 0 ; i < event_starts.size() ; i++){
+    size_t end = (i + 1 < event_starts.size()) ? event_starts[i + 1] : particles.size();
+    sampleVertex(vertex, first_listing + i, particles.data() + event_starts[i], end - event_starts[i]);
+  }
+}
+
+int countLeptoElectrons(const std::vector<ThrownParticle>& particles){
+  // Final-state electrons, each one moves the event_index of LeptoParser
+  int n = 0;
+  for(const ThrownParticle& p : particles){
+    if(p.PID==11) n++;
+  }
+  return n;
+}
+
+Long64_t countEvents(const std::vector<ThrownParticle>& particles){
+  // Number of scattered electrons, i.e. of events in the output
+  Long64_t n = 0;
+  for(const ThrownParticle& p : particles){
+    if(p.PID==11 && p.parent_PID==0) n++;
+  }
+  return n;
+}
+
+#endif
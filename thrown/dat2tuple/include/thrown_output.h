@@ -0,0 +1,216 @@
+// Output trees of the thrown particles
+//   ntuple : the historical all-float TNtuples (default)
+//   typed  : TTrees with a Long64_t event index, an Int_t pid and float or double kinematics
+//   event  : one entry per event, electron once and hadron arrays (event_output.h)
+// Both schemas use the names ntuple_thrown (hadrons) and ntuple_thrown_electrons (electrons), the column order
+// is the same and the typed branch names drop the TeX of the ntuple leaves (x_{bjorken} -> Xb, #theta_{PQ} -> ThetaPQ)
+// With raw records on, the input rows are also written to ntuple_thrown_raw.
+// The fill methods are virtual so other backends (rntuple_output.h) take the same rows.
+// With a job report set, every fill is timed (job_report.h).
+
+// author : Esteban Molina
+
+#ifndef THROWN_OUTPUT_H
+#define THROWN_OUTPUT_H
+
+#include "job_report.h"
+#include "TTree.h"
+#include "TNtuple.h"
+
+#include <string>
+
+const int kNvarsHadron   = 22;	// hadron columns without pid
+const int kNvarsElectron = 12;
+const int kNvarsRaw      = 7;	// raw columns without event_index, PID and parent_PID
+
+const char* const kHadronBranches[kNvarsHadron]     = {"Q2", "Xb", "Nu", "W", "y", "Zh", "Pt2", "Pl2", "ThetaPQ", "PhiPQ", "Theta", "Phi", "P",
+							"Px", "Py", "Pz", "Theta_el", "Phi_el", "P_el", "Px_el", "Py_el", "Pz_el"};
+const char* const kElectronBranches[kNvarsElectron] = {"Q2", "Xb", "Nu", "W", "y", "Theta", "Phi", "P", "Px", "Py", "Pz", "vz"};
+const char* const kRawBranches[kNvarsRaw]           = {"Px", "Py", "Pz", "E", "x", "y", "z"};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class ThrownOutput{
+protected:
+  bool       typed;
+  bool       use_double;
+  TTree*     hadrons;
+  TTree*     electrons;
+  TTree*     raw;
+  TTree*     events;
+  bool       with_raw;
+  Long64_t   first_event;
+  JobReport* report;
+
+  // Buffers of the branches
+  Long64_t event_h, event_el, event_raw;
+  Int_t    pid, raw_PID, raw_parent_PID;
+  double   vars_h_d[kNvarsHadron];
+  float    vars_h_f[kNvarsHadron + 1];	// + pid for the ntuple schema
+  double   vars_el_d[kNvarsElectron];
+  float    vars_el_f[kNvarsElectron];
+  double   vars_raw_d[kNvarsRaw + 3];	// + event_index, PID and parent_PID for the ntuple schema
+  float    vars_raw_f[kNvarsRaw];
+
+  // For the other backends, which book their own columns
+  ThrownOutput(bool typed, bool use_double);
+
+  void bookTyped(TTree* t, const char* event_name, Long64_t* event, int n_vars, const char* const* names, double* vars_d, float* vars_f);
+  void bookRaw();
+
+public:
+  // Creates the trees in the current directory. basket_size <= 0 keeps the ROOT default
+  ThrownOutput(const std::string& schema, bool use_double, int basket_size, bool write_raw);
+  virtual ~ThrownOutput();
+
+  // Trees of the TTree backend (0 for the other backends)
+  TTree*   getHadronTree()	{return hadrons;}
+  TTree*   getElectronTree()	{return electrons;}
+  TTree*   getRawTree()		{return raw;}
+  TTree*   getEventTree()	{return events;}	// event schema only
+
+  // Index given to the first event filled (events of the previous chunks when converting in parallel)
+  void     setFirstEvent(Long64_t event)	{first_event = event;}
+  Long64_t getFirstEvent()			{return first_event;}
+
+  // Timers and counters of the job, 0 (default) to skip them
+  virtual void setReport(JobReport* r)	{report = r;}
+  JobReport*   getReport()		{return report;}
+
+  // vars in the order of kHadronBranches/kElectronBranches/kRawBranches. The ntuple schema has no event column
+  virtual void fillHadron(Long64_t event, double PID, const double* vars);
+  virtual void fillElectron(Long64_t event, const double* vars);
+  virtual void fillRaw(Long64_t event_index, double PID, double parent_PID, const double* vars);
+  bool         hasRaw()	{return with_raw;}
+
+  // Fills the rows still pending (the last event of the event schema) without writing the trees
+  virtual void flush()	{}
+  // Writes the output in the current directory
+  virtual void write();
+};
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+ThrownOutput::ThrownOutput(bool t, bool dbl) :
+  typed(t), use_double(dbl), hadrons(0), electrons(0), raw(0), events(0), with_raw(false), first_event(0), report(0), event_h(0), event_el(0), event_raw(0), pid(0), raw_PID(0), raw_parent_PID(0){}
+
+ThrownOutput::ThrownOutput(const std::string& schema, bool dbl, int basket_size, bool write_raw) : ThrownOutput(schema == "typed", dbl){
+  // Class constructor
+  if(!typed){
+    electrons	= new TNtuple("ntuple_thrown_electrons","","Q2:x_{bjorken}:#nu:W:y:#theta:#phi:p:p_{x}:p_{y}:p_{z}:vz");
+    hadrons	= new TNtuple("ntuple_thrown"          ,"","Q2:x_{bjorken}:#nu:W:y:z_{h}:Pt2:Pl2:#theta_{PQ}:#phi_{PQ}:#theta:#phi:p:p_{x}:p_{y}:p_{z}:#theta_{el}:#phi_{el}:p_{el}:p_{xel}:p_{yel}:p_{zel}:pid");
+  }
+  else{
+    electrons	= new TTree("ntuple_thrown_electrons","");
+    hadrons	= new TTree("ntuple_thrown","");
+    bookTyped(electrons, "event", &event_el, kNvarsElectron, kElectronBranches, vars_el_d, vars_el_f);
+    bookTyped(hadrons,   "event", &event_h,  kNvarsHadron,   kHadronBranches,   vars_h_d,  vars_h_f);
+    hadrons->Branch("pid", &pid, "pid/I");
+  }
+
+  with_raw = write_raw;
+  if(write_raw) bookRaw();
+
+  if(basket_size > 0){
+    for(TTree* t : {hadrons, electrons, raw}){
+      if(t) t->SetBasketSize("*", basket_size);
+    }
+  }
+}
+
+ThrownOutput::~ThrownOutput(){}
+
+void ThrownOutput::bookRaw(){
+  raw = new TTree("ntuple_thrown_raw","");
+  if(!typed){
+    // Same columns as the tree made by TTree::ReadFile
+    const char* names[kNvarsRaw + 3] = {"event_index", "PID", "parent_PID", "Px", "Py", "Pz", "E", "x", "y", "z"};
+    for(int i = 0 ; i < kNvarsRaw + 3 ; i++) raw->Branch(names[i], &vars_raw_d[i], (std::string(names[i]) + "/D").c_str());
+  }
+  else{
+    bookTyped(raw, "event_index", &event_raw, kNvarsRaw, kRawBranches, vars_raw_d, vars_raw_f);
+    raw->Branch("PID",        &raw_PID,        "PID/I");
+    raw->Branch("parent_PID", &raw_parent_PID, "parent_PID/I");
+  }
+}
+
+void ThrownOutput::bookTyped(TTree* t, const char* event_name, Long64_t* event, int n_vars, const char* const* names, double* vars_d, float* vars_f){
+  t->Branch(event_name, event, (std::string(event_name) + "/L").c_str());
+  for(int i = 0 ; i < n_vars ; i++){
+    std::string leaf = std::string(names[i]) + (use_double ? "/D" : "/F");
+    if(use_double) t->Branch(names[i], &vars_d[i], leaf.c_str());
+    else           t->Branch(names[i], &vars_f[i], leaf.c_str());
+  }
+}
+
+void ThrownOutput::fillHadron(Long64_t event, double PID, const double* vars){
+  FillTimer timer(report, hadrons);
+  if(use_double && typed){
+    for(int i = 0 ; i < kNvarsHadron ; i++) vars_h_d[i] = vars[i];
+  }
+  else{
+    for(int i = 0 ; i < kNvarsHadron ; i++) vars_h_f[i] = (float) vars[i];
+  }
+
+  if(typed){
+    event_h = event;
+    pid     = (Int_t) PID;
+    hadrons->Fill();
+  }
+  else{
+    vars_h_f[kNvarsHadron] = (float) PID;
+    ((TNtuple*) hadrons)->Fill(vars_h_f);
+  }
+}
+
+void ThrownOutput::fillElectron(Long64_t event, const double* vars){
+  FillTimer timer(report, electrons);
+  if(use_double && typed){
+    for(int i = 0 ; i < kNvarsElectron ; i++) vars_el_d[i] = vars[i];
+  }
+  else{
+    for(int i = 0 ; i < kNvarsElectron ; i++) vars_el_f[i] = (float) vars[i];
+  }
+
+  if(typed){
+    event_el = event;
+    electrons->Fill();
+  }
+  else{
+    ((TNtuple*) electrons)->Fill(vars_el_f);
+  }
+}
+
+void ThrownOutput::fillRaw(Long64_t event_index, double PID, double parent_PID, const double* vars){
+  if(!raw) return;
+  FillTimer timer(report, raw);
+
+  if(typed){
+    event_raw      = event_index;
+    raw_PID        = (Int_t) PID;
+    raw_parent_PID = (Int_t) parent_PID;
+    for(int i = 0 ; i < kNvarsRaw ; i++){
+      if(use_double) vars_raw_d[i] = vars[i];
+      else           vars_raw_f[i] = (float) vars[i];
+    }
+  }
+  else{
+    vars_raw_d[0] = event_index;
+    vars_raw_d[1] = PID;
+    vars_raw_d[2] = parent_PID;
+    for(int i = 0 ; i < kNvarsRaw ; i++) vars_raw_d[i + 3] = vars[i];
+  }
+  raw->Fill();
+}
+
+void ThrownOutput::write(){
+  hadrons->Write();
+  electrons->Write();
+  if(raw) raw->Write();
+}
+
+#endif
@@ -0,0 +1,94 @@
+// Per-event z vertex sampled inside the cryotarget (--lD2_length=<1-5> or --z_range=<min>,<max>, with --job_id=<N>)
+// Replaces random_gen.py and vertex.py, which drew one vertex per job. Every LEPTO event gets its own vertex,
+// uniform in the z extent of the target, from a counter-based generator (Philox4x32-10, Salmon et al. SC'11) :
+//   key     : the job id, a 64-bit number that has to differ between the jobs. The scripts pass
+//             $((SLURM_ARRAY_JOB_ID*1000000 + SLURM_ARRAY_TASK_ID)), unique while the task ids stay below 10^6
+//             (SLURM's default MaxArraySize is 1001) and the job ids below 9e12 (bash arithmetic is signed 64-bit).
+//             Concatenating the two ids is not unique : job 1234 task 56 and job 12345 task 6 would both give 123456
+//   counter : the number of the event listing in the input (0, 1, 2, ...)
+// The vertex of an event depends only on these two numbers, so it is the same whatever --threads and --chunk_size are,
+// no state is shared between the worker threads, and rerunning a job gives back the same vertices.
+
+// author : Esteban Molina
+
+#ifndef VERTEX_SAMPLER_H
+#define VERTEX_SAMPLER_H
+
+#include <cstdint>
+
+// Extension of the cryotarget (mm), as in vertex.py
+// kCryoTargetZ[0] : 1cmlD2
+// kCryoTargetZ[1] : 2cmlD2
+// kCryoTargetZ[2] : 3cmlD2
+// kCryoTargetZ[3] : 4cmlD2
+// kCryoTargetZ[4] : 5cmlD2
+const int    kNcryoTargets = 5;
+const double kCryoTargetZ[kNcryoTargets][2] = {{-4.2,4.5},{-9.2,9.5},{-14.2,14.5},{-19.2,19.5},{-24.2,24.5}};
+
+//####################################################################################################################//
+//########################################     CLASSES DECLARATIONS      #############################################//
+//####################################################################################################################//
+
+class VertexSampler{
+  uint32_t key[2];
+  double   z_min, z_width;
+
+  // 4 random words of the counter
+  void philox(uint64_t counter, uint32_t* out) const;
+
+public:
+  // z range in cm
+  VertexSampler(unsigned long long job_id, double z_min, double z_max);
+  ~VertexSampler();
+
+  // Uniform number in [0,1) of an event, 53 random bits
+  double getUniform(long long event) const;
+  // z vertex (cm) of an event
+  double getZ(long long event) const;
+};
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+VertexSampler::VertexSampler(unsigned long long job_id, double zmin, double zmax) : z_min(zmin), z_width(zmax - zmin){
+  // Class constructor
+  key[0] = (uint32_t) job_id;
+  key[1] = (uint32_t) (job_id >> 32);
+}
+
+VertexSampler::~VertexSampler(){}
+
+void VertexSampler::philox(uint64_t counter, uint32_t* c) const{
+  // Philox4x32 with 10 rounds
+  c[0] = (uint32_t) counter;
+  c[1] = (uint32_t) (counter >> 32);
+  c[2] = 0;
+  c[3] = 0;
+  uint32_t k0 = key[0], k1 = key[1];
+  for(int round = 0 ; round < 10 ; round++){
+    uint64_t product0 = (uint64_t) 0xD2511F53u*c[0];
+    uint64_t product1 = (uint64_t) 0xCD9E8D57u*c[2];
+    uint32_t hi0 = product0 >> 32, lo0 = (uint32_t) product0;
+    uint32_t hi1 = product1 >> 32, lo1 = (uint32_t) product1;
+    c[0] = hi1 ^ c[1] ^ k0;
+    c[1] = lo1;
+    c[2] = hi0 ^ c[3] ^ k1;
+    c[3] = lo0;
+    k0  += 0x9E3779B9u;
+    k1  += 0xBB67AE85u;
+  }
+}
+
+double VertexSampler::getUniform(long long event) const{
+  uint32_t c[4];
+  philox((uint64_t) event, c);
+  uint64_t bits = (((uint64_t) c[0] << 32) | c[1]) >> 11;
+  return bits*(1./9007199254740992.);
+}
+
+double VertexSampler::getZ(long long event) const{
+  return z_min + getUniform(event)*z_width;
+}
+
+#endif
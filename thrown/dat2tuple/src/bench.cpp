@@ -0,0 +1,286 @@
+// Benchmarks of dat2tuple on synthetic LEPTO events (event_generator.h)
+//   parsing     : LeptoParser, DatReader and FastDatReader over inputs kept in memory
+//   kinematics  : LeptonicKinematics/HadronicKinematics, and the reference/fused/batch fillers without output
+//   filling     : ntuple, typed, event and RNTuple outputs filled and written to a file
+//   end-to-end  : conversion of .dat and LEPTO files on disk, in events/s and MB/s of input
+// Run it before and after a change, on the same node, to judge an optimization or catch a regression.
+
+// usage : ./bench [n_events] [--multiplicity=<N>] [--beam_energy=<GeV>] [--seed=<N>] [--kinematics=reference|fused|batch] [--tmp=<dir>]
+//         make bench [BENCH_EVENTS=<N>]
+
+// author : Esteban Molina
+
+#include "dat2tuple.h"
+#include "thrown_filler.h"
+#include "event_generator.h"
+#include "monitoring.h"
+#include "options.h"
+#include "TFile.h"
+#include "TROOT.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+// Output that only keeps a checksum of the columns, so the fillers are timed without I/O
+class NullOutput : public ThrownOutput{
+public:
+  double checksum;
+
+  NullOutput() : ThrownOutput(true, false), checksum(0.){}
+
+  void fillHadron(Long64_t event, double PID, const double* vars)			{checksum += vars[5] + vars[8];}
+  void fillElectron(Long64_t event, const double* vars)					{checksum += vars[0];}
+  void fillRaw(Long64_t event_index, double PID, double parent_PID, const double* vars)	{}
+  void write()										{}
+};
+
+class Stopwatch{
+  std::chrono::steady_clock::time_point start;
+
+public:
+  Stopwatch() : start(std::chrono::steady_clock::now()){}
+  double seconds()	{return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();}
+};
+
+void printResult(const char* name, double seconds, double n_items, const char* items, double bytes = 0.){
+  // One line of the report : time, items per second and, if bytes are given, MB/s
+  std::printf("  %-34s %9.3f s %12.0f %s/s", name, seconds, n_items/seconds, items);
+  if(bytes > 0.) std::printf(" %9.1f MB/s", bytes/1024./1024./seconds);
+  std::printf("\n");
+}
+
+double getFileSize(const std::string& file_name){
+  struct stat st;
+  if(stat(file_name.c_str(), &st) != 0) return 0.;
+  return st.st_size;
+}
+
+bool writeText(const std::string& file_name, const std::string& text){
+  std::ofstream out(file_name);
+  out.write(text.data(), text.size());
+  return out.good();
+}
+
+template<class Run>
+void fillOutput(Options& opt, const Run& run, const std::vector<ThrownParticle>& particles, const std::string& file_name,
+		const char* name, double n_events){
+  // Fills and writes the output described by opt, both steps are timed
+  Stopwatch fill_time;
+  TFile* f = new TFile(file_name.c_str(), "RECREATE", "", getCompressionSettings(opt));
+  f->cd();
+  ThrownOutput* output = bookThrownOutput(opt, f);
+  {
+    ThrownFiller<Run> filler(output, run, "fused");
+    fillFromParticles(particles, filler);
+  }
+  double t_fill = fill_time.seconds();
+
+  Stopwatch write_time;
+  f->cd();
+  output->write();
+  delete output;
+  f->Close();
+  gROOT->cd();
+  delete f;
+  double t_write = write_time.seconds();
+
+  double size = getFileSize(file_name);
+  std::string fill_name  = std::string(name) + " fill";
+  std::string write_name = std::string(name) + " write";
+  printResult(fill_name.c_str(),  t_fill,  n_events, "events");
+  printResult(write_name.c_str(), t_write, n_events, "events", size);
+  std::printf("  %-34s %9.2f MB\n", (std::string(name) + " file size").c_str(), size/1024./1024.);
+  std::remove(file_name.c_str());
+}
+
+template<class Run>
+void convertFile(Options& opt, const Run& run, const std::string& file_out, const char* name, double n_events){
+  // Same steps as a streaming conversion of dat2tuple : open, fill, write and close
+  Stopwatch time;
+  std::ifstream  file;
+  FastDatReader* fast_in = 0;
+  if(opt.input == "dat" && opt.reader == "fast") fast_in = new FastDatReader(opt.file_in.c_str());
+  else                                            file.open(opt.file_in);
+
+  TFile* f = new TFile(file_out.c_str(), "RECREATE", "", getCompressionSettings(opt));
+  f->cd();
+  ThrownOutput* output = bookThrownOutput(opt, f);
+  {
+    ThrownFiller<Run> filler(output, run, opt.kinematics);
+    if(fast_in) fillFromRows(*fast_in, filler);
+    else        fillFromStream(file, opt.input, run, filler, 0);
+  }
+  delete fast_in;
+
+  f->cd();
+  output->write();
+  delete output;
+  f->Close();
+  gROOT->cd();
+  delete f;
+
+  printResult(name, time.seconds(), n_events, "events", getFileSize(opt.file_in));
+  std::remove(file_out.c_str());
+}
+
+int main(int argc, char** argv){
+
+  long          n_events     = 100000;
+  double        multiplicity = 4.;
+  double        beam_energy  = kEbeam;
+  unsigned long seed         = 12345;
+  std::string   kinematics   = "reference";
+  std::string   tmp_dir      = "/tmp";
+  for(int i = 1 ; i < argc ; i++){
+    const char* arg   = argv[i];
+    const char* value = std::strchr(arg, '=');
+    if(arg[0] != '-')                                       n_events     = std::atol(arg);
+    else if(value && std::strncmp(arg, "--multiplicity=", 15) == 0) multiplicity = std::atof(value + 1);
+    else if(value && std::strncmp(arg, "--beam_energy=", 14) == 0)  beam_energy  = std::atof(value + 1);
+    else if(value && std::strncmp(arg, "--seed=", 7) == 0)          seed         = std::strtoul(value + 1, nullptr, 10);
+    else if(value && std::strncmp(arg, "--kinematics=", 13) == 0)   kinematics   = value + 1;
+    else if(value && std::strncmp(arg, "--tmp=", 6) == 0)           tmp_dir      = value + 1;
+    else{
+      std::cout<<"Usage : ./bench [n_events] [--multiplicity=<N>] [--beam_energy=<GeV>] [--seed=<N>] [--kinematics=reference|fused|batch] [--tmp=<dir>]"<<std::endl;
+      return 1;
+    }
+  }
+  if(n_events <= 0 || multiplicity <= 0. || beam_energy <= 0.){
+    std::cout<<"Wrong number of events, multiplicity or beam energy"<<std::endl;
+    return 1;
+  }
+
+  RunConstants run(beam_energy, kMassProton, 0.);
+  std::printf("dat2tuple benchmark : %ld events, multiplicity %.1f, beam energy %.1f GeV\n", n_events, multiplicity, beam_energy);
+
+  // Synthetic inputs
+  std::printf("generation\n");
+  EventGenerator generator(seed, beam_energy, multiplicity);
+  std::string listing, rows;
+  Stopwatch gen_time;
+  generator.header(listing);
+  for(long i = 0 ; i < n_events ; i++) generator.generate(listing);
+  printResult("LEPTO listings", gen_time.seconds(), n_events, "events", listing.size());
+  Stopwatch dat_time;
+  listingToDat(listing, 0., rows);
+  printResult(".dat rows (LeptoParser)", dat_time.seconds(), n_events, "events", rows.size());
+
+  // Parsing
+  std::printf("parsing\n");
+  std::vector<ThrownParticle> particles, event;
+  particles.reserve(rows.size()/80);
+  {
+    std::istringstream in(listing);
+    Stopwatch time;
+    LeptoParser parser(in, 0.);
+    while(parser.nextEvent(event)) {}
+    printResult("LeptoParser", time.seconds(), n_events, "events", listing.size());
+  }
+  {
+    std::istringstream in(rows);
+    Stopwatch time;
+    DatReader reader(in);
+    ThrownParticle p;
+    while(reader.nextRow(p)) {}
+    printResult("DatReader", time.seconds(), reader.getNrows(), "rows", rows.size());
+  }
+  {
+    Stopwatch time;
+    FastDatReader reader(rows.data(), rows.size());
+    readRows(reader, particles);
+    printResult("FastDatReader", time.seconds(), reader.getNrows(), "rows", rows.size());
+  }
+  double n_particles = particles.size();
+  double n_hadrons   = 0.;
+  for(const ThrownParticle& p : particles){
+    if(p.PID != 11 && p.PID != 22 && p.PID != -11) n_hadrons++;
+  }
+  std::printf("  %ld particles, %.0f hadrons\n", (long) n_particles, n_hadrons);
+
+  // Kinematics
+  std::printf("kinematics\n");
+  {
+    Stopwatch time;
+    double checksum = 0.;
+    LeptonicKinematics<RunConstants>* lk = 0;
+    for(const ThrownParticle& p : particles){
+      if(p.PID==11 && p.parent_PID==0){
+	delete lk;
+	lk = new LeptonicKinematics<RunConstants>(p.Px, p.Py, p.Pz, run);
+	checksum += lk->getQ2() + lk->getXb() + lk->getW();
+      }
+      else if(lk && p.PID != 11 && p.PID != 22 && p.PID != -11){
+	HadronicKinematics<RunConstants> hk(p.Px, p.Py, p.Pz, p.PID);
+	checksum += hk.getZh(lk) + hk.getPt2(lk) + hk.getPl2(lk) + hk.getThetaPQ(lk) + hk.getPhiPQ(lk) + hk.getThetaLab_h();
+      }
+    }
+    delete lk;
+    printResult("Leptonic/HadronicKinematics", time.seconds(), n_hadrons, "hadrons");
+    if(checksum == 0.) std::printf("  (checksum 0)\n");
+  }
+  for(const char* k : {"reference", "fused", "batch"}){
+    NullOutput output;
+    Stopwatch time;
+    {
+      ThrownFiller<RunConstants> filler(&output, run, k);
+      fillFromParticles(particles, filler);
+    }
+    std::string name = std::string("filler ") + k;
+    printResult(name.c_str(), time.seconds(), n_hadrons, "hadrons");
+  }
+
+  // Filling and writing
+  std::printf("filling and writing (fused kinematics, default compression)\n");
+  std::string file_out = tmp_dir + "/dat2tuple_bench.root";
+  {
+    Options opt;
+    fillOutput(opt, run, particles, file_out, "ntuple", n_events);
+    opt.schema = "typed";
+    fillOutput(opt, run, particles, file_out, "typed float", n_events);
+    opt.precision = "double";
+    fillOutput(opt, run, particles, file_out, "typed double", n_events);
+    opt.schema    = "event";
+    opt.precision = "float";
+    fillOutput(opt, run, particles, file_out, "event float", n_events);
+    opt.schema    = "typed";
+    opt.backend   = "rntuple";
+    fillOutput(opt, run, particles, file_out, "rntuple float", n_events);
+  }
+
+  // End-to-end
+  std::printf("end-to-end (--kinematics=%s --stream)\n", kinematics.c_str());
+  std::string dat_file   = tmp_dir + "/dat2tuple_bench.dat";
+  std::string lepto_file = tmp_dir + "/dat2tuple_bench.lepto";
+  if(!writeText(dat_file, rows) || !writeText(lepto_file, listing)){
+    std::cout<<"Could not write the inputs in "<<tmp_dir<<std::endl;
+    return 1;
+  }
+  rows.clear();
+  rows.shrink_to_fit();
+  listing.clear();
+  listing.shrink_to_fit();
+  {
+    Options opt;
+    opt.kinematics = kinematics;
+    opt.file_in    = dat_file;
+    convertFile(opt, run, file_out, ".dat", n_events);
+    opt.reader = "fast";
+    convertFile(opt, run, file_out, ".dat --reader=fast", n_events);
+    opt.input   = "lepto";
+    opt.file_in = lepto_file;
+    convertFile(opt, run, file_out, "LEPTO --input=lepto", n_events);
+  }
+  std::remove(dat_file.c_str());
+  std::remove(lepto_file.c_str());
+
+  std::printf("Peak RSS : %.1f MB\n", getPeakRSS());
+
+  return 0;
+}
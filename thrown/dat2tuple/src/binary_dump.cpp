@@ -0,0 +1,37 @@
+// Prints a binary event file (binary_format.h) in the .dat format of lepto2dat.pl
+// Only needs binary_format.h, no ROOT
+
+// usage : ./binary_dump <binary_file> [first_event] [n_events]
+
+// author : Esteban Molina
+
+#include "binary_format.h"
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char** argv){
+
+  if(argc < 2){
+    std::printf("Usage : ./binary_dump <binary_file> [first_event] [n_events]\n");
+    return 0;
+  }
+
+  BinaryEventReader reader(argv[1]);
+  if(!reader.isOpen()){
+    std::printf("Could not open %s as a binary event file\n", argv[1]);
+    return 1;
+  }
+
+  uint64_t first = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 0;
+  uint64_t n     = (argc > 3) ? std::strtoull(argv[3], nullptr, 10) : reader.getNevents();
+  uint64_t last  = (first + n < reader.getNevents()) ? first + n : reader.getNevents();
+
+  for(uint64_t event = first ; event < last ; event++){
+    for(const BinaryParticle* p = reader.getEventBegin(event) ; p != reader.getEventEnd(event) ; p++){
+      std::printf("%4d %4d %4d %9.7f %9.7f %9.7f %9.7f %9.7f %9.7f %9.7f\n",
+		  p->event_index, p->PID, p->parent_PID, p->Px, p->Py, p->Pz, p->E, p->x, p->y, p->z);
+    }
+  }
+
+  return 0;
+}
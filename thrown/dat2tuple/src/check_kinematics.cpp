@@ -0,0 +1,197 @@
+// Regression check of the fused hadron-frame kinematics (hadron_frame.h) and of the vectorized blocks of
+// --kinematics=batch (BatchFiller, batch_kinematics.h) against the reference LeptonicKinematics/HadronicKinematics classes.
+// The batch rows are filled through BatchFiller and compared column by column with the rows of fillThrown
+
+// usage : ./check_kinematics [.dat file]
+//         Without a file, electrons and hadrons are sampled uniformly in the CLAS12 range
+
+// Tolerances : relative 1e-9 for zh, Pt2, Pl2 and momenta
+//              absolute 1e-6 degrees for the angles (the reference uses acos, which loses
+//              precision close to thetaPQ = 0; phiPQ is not checked below thetaPQ = 1e-3 degrees,
+//              where it is undefined)
+
+// author : Esteban Molina
+
+#include "dat2tuple.h"
+#include "hadron_frame.h"
+#include "dat_reader.h"
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <cmath>
+#include <vector>
+
+const double kRelTolerance   = 1e-9;
+const double kAngleTolerance = 1e-6;
+
+struct Check{
+  const char* name;
+  double      max_diff;
+  long        n_fail;
+};
+
+// Output that keeps the rows of a filler, to compare them with the reference ones
+class RowRecorder : public ThrownOutput{
+public:
+  std::vector<double> electrons, hadrons;	// event, columns (and pid for the hadrons) of every row
+
+  RowRecorder() : ThrownOutput(false, true){}
+
+  void fillElectron(Long64_t event, const double* vars){
+    electrons.push_back(event);
+    electrons.insert(electrons.end(), vars, vars + kNvarsElectron);
+  }
+  void fillHadron(Long64_t event, double PID, const double* vars){
+    hadrons.push_back(event);
+    hadrons.insert(hadrons.end(), vars, vars + kNvarsHadron);
+    hadrons.push_back(PID);
+  }
+  void clear(){
+    electrons.clear();
+    hadrons.clear();
+  }
+};
+
+void compare(Check& c, double ref, double val, bool is_angle){
+  // Records the difference between reference and fused values
+  double diff = std::fabs(ref - val);
+  if(is_angle && diff > 180.) diff = 360. - diff;	// phi close to +-180
+  if(!is_angle) diff /= std::max(1., std::fabs(ref));
+  if(std::isnan(ref) && std::isnan(val)) diff = 0.;
+  if(diff > c.max_diff || std::isnan(diff)) c.max_diff = diff;
+  if(!(diff <= (is_angle ? kAngleTolerance : kRelTolerance))) c.n_fail++;
+}
+
+int main(int argc, char** argv){
+
+  Check checks[7] = {{"P_h",0,0}, {"theta_h",0,0}, {"zh",0,0}, {"Pt2",0,0}, {"Pl2",0,0}, {"thetaPQ",0,0}, {"phiPQ",0,0}};
+  long n_hadrons = 0;
+
+  // Columns of the batch rows, angles in degrees
+  Check batch_el[kNvarsElectron], batch_h[kNvarsHadron];
+  Check batch_rows = {"event/pid", 0, 0};
+  const bool angle_el[kNvarsElectron] = {0, 0, 0, 0, 0, 1, 1};
+  const bool angle_h[kNvarsHadron]    = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1};
+  for(int i = 0 ; i < kNvarsElectron ; i++) batch_el[i] = {kElectronBranches[i], 0, 0};
+  for(int i = 0 ; i < kNvarsHadron ; i++)   batch_h[i]  = {kHadronBranches[i], 0, 0};
+
+  RunConstants              run;
+  RowRecorder               ref_rows, batch_out;
+  BatchFiller<RunConstants> batch(&batch_out, run);
+  LeptonicKinematics<>      ref_lk(0., 0., 0.);
+  Long64_t                  ref_event = -1;
+  long                      n_batch   = 0;
+
+  auto fill_rows = [&](double PID, double parent_PID, double Px, double Py, double Pz, double z){
+    fillThrown(&ref_rows, ref_lk, ref_event, run, PID, parent_PID, Px, Py, Pz, z);
+    batch.fill(PID, parent_PID, Px, Py, Pz, z);
+  };
+
+  auto check_batch = [&](){
+    // Rows filled so far, the batch ones once their blocks are computed
+    batch.flush();
+    if(ref_rows.electrons.size() != batch_out.electrons.size() || ref_rows.hadrons.size() != batch_out.hadrons.size()){
+      batch_rows.n_fail++;
+      ref_rows.clear();
+      batch_out.clear();
+      return;
+    }
+    const int el_size = kNvarsElectron + 1, h_size = kNvarsHadron + 2;
+    for(size_t row = 0 ; row < ref_rows.electrons.size() ; row += el_size){
+      const double* ref = &ref_rows.electrons[row];
+      const double* val = &batch_out.electrons[row];
+      if(ref[0] != val[0]) batch_rows.n_fail++;
+      for(int i = 0 ; i < kNvarsElectron ; i++) compare(batch_el[i], ref[i + 1], val[i + 1], angle_el[i]);
+    }
+    for(size_t row = 0 ; row < ref_rows.hadrons.size() ; row += h_size){
+      const double* ref = &ref_rows.hadrons[row];
+      const double* val = &batch_out.hadrons[row];
+      if(ref[0] != val[0] || ref[h_size - 1] != val[h_size - 1]) batch_rows.n_fail++;
+      for(int i = 0 ; i < kNvarsHadron ; i++){
+	// phiPQ is undefined along q, as above
+	if(i == 9 && ref[9] <= 1e-3) continue;
+	compare(batch_h[i], ref[i + 1], val[i + 1], angle_h[i]);
+      }
+      n_batch++;
+    }
+    ref_rows.clear();
+    batch_out.clear();
+  };
+
+  auto check_hadron = [&](LeptonicKinematics<>& lk, VirtualPhotonFrame<>& frame, double Px, double Py, double Pz, double PID){
+    HadronicKinematics<> hk(Px, Py, Pz, PID);
+    HadronFrameVars h;
+    frame.compute(Px, Py, Pz, HadronicKinematics<>::getMass_h(PID), h);
+
+    compare(checks[0], hk.getP_h(),         h.P_h,        false);
+    compare(checks[1], hk.getThetaLab_h(),  h.ThetaLab_h, true);
+    compare(checks[2], hk.getZh(&lk),       h.Zh,         false);
+    compare(checks[3], hk.getPt2(&lk),      h.Pt2,        false);
+    compare(checks[4], hk.getPl2(&lk),      h.Pl2,        false);
+    compare(checks[5], hk.getThetaPQ(&lk),  h.ThetaPQ,    true);
+    if(h.ThetaPQ > 1e-3) compare(checks[6], hk.getPhiPQ(&lk), h.PhiPQ, true);
+    n_hadrons++;
+  };
+
+  if(argc > 1){
+    // Rows of a .dat file
+    std::ifstream file(argv[1]);
+    if(!file.is_open()){
+      std::cout<<"Could not open "<<argv[1]<<std::endl;
+      return 1;
+    }
+    DatReader reader(file);
+    ThrownParticle p;
+    LeptonicKinematics<> lk(0., 0., 0.);
+    VirtualPhotonFrame<> frame(lk);
+    while(reader.nextRow(p)){
+      fill_rows(p.PID, p.parent_PID, p.Px, p.Py, p.Pz, p.z);
+      if(p.PID==11 && p.parent_PID==0){
+	if(ref_rows.hadrons.size() > 100000) check_batch();
+	lk    = LeptonicKinematics<>(p.Px, p.Py, p.Pz);
+	frame = VirtualPhotonFrame<>(lk);
+      }
+      else if(p.PID != 11 && p.PID != 22 && p.PID != -11) check_hadron(lk, frame, p.Px, p.Py, p.Pz, p.PID);
+    }
+  }
+  else{
+    // Random events, fixed seed so failures can be reproduced
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<double> uniform(-1., 1.);
+    const double pids[5] = {211, -211, 321, 2212, 111};
+    for(int event = 0 ; event < 100000 ; event++){
+      double elP[3] = {0.8*uniform(gen), 0.8*uniform(gen), 6. + 3.*uniform(gen)};
+      LeptonicKinematics<> lk(elP[0], elP[1], elP[2]);
+      VirtualPhotonFrame<> frame(lk);
+      fill_rows(11, 0, elP[0], elP[1], elP[2], 0.);
+      for(int i = 0 ; i < 5 ; i++){
+	double hP[3] = {uniform(gen), uniform(gen), 2. + 2.*uniform(gen)};
+	check_hadron(lk, frame, hP[0], hP[1], hP[2], pids[i]);
+	fill_rows(pids[i], 1, hP[0], hP[1], hP[2], 0.);
+      }
+      if(ref_rows.hadrons.size() > 100000) check_batch();
+    }
+  }
+  check_batch();
+
+  bool ok = true;
+  std::cout<<"Checked "<<n_hadrons<<" hadrons (fused)"<<std::endl;
+  for(const Check& c : checks){
+    std::cout<<"  "<<c.name<<"\t max difference = "<<c.max_diff<<"\t failures = "<<c.n_fail<<std::endl;
+    if(c.n_fail > 0) ok = false;
+  }
+  std::cout<<"Checked "<<n_batch<<" hadrons (batch)"<<std::endl;
+  std::cout<<"  "<<batch_rows.name<<"\t failures = "<<batch_rows.n_fail<<std::endl;
+  if(batch_rows.n_fail > 0) ok = false;
+  for(const Check& c : batch_el){
+    std::cout<<"  el "<<c.name<<"\t max difference = "<<c.max_diff<<"\t failures = "<<c.n_fail<<std::endl;
+    if(c.n_fail > 0) ok = false;
+  }
+  for(const Check& c : batch_h){
+    std::cout<<"  h "<<c.name<<"\t max difference = "<<c.max_diff<<"\t failures = "<<c.n_fail<<std::endl;
+    if(c.n_fail > 0) ok = false;
+  }
+  std::cout<<(ok ? "PASSED" : "FAILED")<<std::endl;
+
+  return ok ? 0 : 1;
+}
@@ -3,83 +3,345 @@
 // Req: .dat file has to have the following format
 //      <event_index> <particle_id> <parent_id> <px> <py> <pz> <E> <x> <y> <z>
 // Pro Tip: Use lepto2dat.pl (wink wink)
+//      or pass the raw LEPTO output directly with --input=lepto --z_vertex=<cm>
+//      (add --lund=<file> to write the GEMC input from the same parse, and --index to write its event index, event_index.h)
+//      --lD2_length=<1-5> or --z_range=<min>,<max> with --job_id=<N> samples the vertex of every LEPTO event (vertex_sampler.h)
+//      Use --stream [--max_memory=<MB>] for inputs that do not fit in memory
+//      Beam energy and target mass are set with --beam_energy=<GeV> --target_mass=<GeV>
+//      --kinematics=fused|batch computes the kinematics with hadron_frame.h or the vectorized kernels of batch_kinematics.h
+//      The kinematics (kinematics.h) are also built as bin/libThrownKinematics.so for RDataFrame macros (kinematics_functors.h, make lib)
+//      --threads=<N> converts chunks of the input in parallel (parallel_convert.h), the output is the same as with 1 thread
+//      --schema=typed writes typed trees (Long64_t event, Int_t pid), --schema=event one entry per event with hadron arrays,
+//      --compression/--basket_size/--auto_flush tune the output
+//      --backend=rntuple writes RNTuples (rntuple_output.h), --raw adds the input rows
+//      --reader=fast parses .dat files with the mapped from_chars reader of fast_dat_reader.h instead of TTree::ReadFile
+//      --binary=<file> also writes the binary event format (binary_format.h), read back with --input=binary
+//      --shards=<N> writes N LUND and ntuple shards of one LEPTO run, balanced by particles, for N GEMC jobs (lund_shards.h)
+//      --merge takes a glob or @list of .dat/ntuple files and writes a single output (merge_inputs.h), replacing hadd
+//      The input can be gzip or zstd compressed, and --lund=<file>.gz|.zst writes the LUND file compressed (compressed_io.h)
+//      The input can be - (stdin) or a FIFO : lepto.exe < lepto.in | ./dat2tuple - out.root (pipe_input.h)
+//      --histograms=<config> fills sparse histograms of the kinematics while converting (histogram_output.h), --no_ntuples only them
+//      --select="Q2>1 && W>2 && zh>0.1" writes only the rows that pass the cuts (selection.h)
+//      --incremental skips inputs whose output is up to date in a manifest and resumes interrupted batches (conversion_cache.h)
+//      --batch=<manifest> converts the jobs listed in a file (one "<input> <output> [options]" per line) on a pool of
+//      --threads=<N> threads that steal work from each other, retrying the failed ones --retries=<N> times (batch_runner.h)
+//      A JSON report with per-stage timers and counters is written next to the output (job_report.h), --report=<file>|none
 
 // author : Esteban Molina (May 2022)
 
 #include "dat2tuple.h"
+#include "thrown_filler.h"
+#include "parallel_convert.h"
+#include "merge_inputs.h"
+#include "lund_shards.h"
+#include "job_report.h"
+#include "pipe_input.h"
+#include "conversion_cache.h"
+#include "batch_runner.h"
+#include "monitoring.h"
+#include "options.h"
 #include "TFile.h"
 #include "TROOT.h"
 #include <iostream>
 #include <fstream>
+#include <memory>
 
-int main(int argc, char** argv){
+template<class Run>
+void convertInput(const Options& opt, const Run& run, std::istream& file, BinaryEventReader* binary_in, FastDatReader* fast_in,
+		  ThrownOutput* output, const Selection* selection, LundWriter* lund, BinaryEventWriter* binary_out, TTree*& t){
+  // Reads the input and fills the ntuples (and the LUND and binary files if requested)
+  ThrownFiller<Run> filler(output, run, opt.kinematics, selection);
 
-  if(argc < 3){
-    std::cout<<"Number of arguments is not correct!"<<std::endl;
-    return 0;
+  if(binary_in){
+    // Binary event file, mapped in memory
+    fillFromBinary(*binary_in, filler);
+  }
+  else if(fast_in){
+    // .dat rows parsed in place, no raw tree
+    fillFromRows(*fast_in, filler, binary_out);
+  }
+  else if(opt.input == "lepto" || opt.stream){
+    // LEPTO event listings, or .dat rows read one by one without the raw tree
+    VertexSampler vertex(opt.job_id, opt.z_min, opt.z_max);
+    fillFromStream(file, opt.input, run, filler, lund, binary_out, opt.sample_vertex ? &vertex : 0);
   }
-  
+  else{
+    // Create Tree that reads file
+    StageTimer read_timer(output->getReport(), kStageRead);
+    t = new TTree("ntuple_thrown_raw","");
+    // Not kept in gROOT, which the conversions running at once share
+    t->SetDirectory(0);
+    // Make the tree read the .dat file
+    t->ReadFile(opt.file_in.c_str(),"event_index/D:PID:parent_PID:Px:Py:Pz:E:x:y:z");
+    read_timer.stop();
+
+    //Process the tree
+    TreeRowReader reader(t);
+    fillFromRows(reader, filler, binary_out);
+  }
+}
+
+template<class Run>
+int convertSerial(const Options& opt, const Run& run, JobReport* report){
+  // Returns 0 on success, 1 otherwise
+  // The files, readers and writers are owned by unique_ptr, so they are closed and deleted on every return
+
   // Input variables
-  const char* file_in  = argv[1];
-  const char* file_out = argv[2];
+  const char* file_in  = opt.file_in.c_str();
+  const char* file_out = opt.file_out.c_str();
 
-  // Open dat file
-  std::ifstream file(file_in);
+  // Open input file
+  std::ifstream                      file;
+  std::istream*                      in          = &file;
+  std::unique_ptr<CompressedInput>   compressed_in;
+  std::unique_ptr<BinaryEventReader> binary_in;
+  std::unique_ptr<FastDatReader>     fast_in;
+  bool                               pipe        = isPipeInput(opt);
+  int                                compression = pipe ? kNoCompression : getCompression(opt.file_in);
+  if(pipe){
+    // Already on std::cin (openPipeInput)
+    in = &std::cin;
+  }
+  else if(compression != kNoCompression){
+    // Decompressed by another thread (openCompressedInput)
+    compressed_in.reset(new CompressedInput(opt.file_in, compression));
+    if(!compressed_in->isOpen()){
+      std::cout<<"Could not open "<<file_in<<std::endl;
+      return 1;
+    }
+    in = compressed_in.get();
+  }
+  else if(opt.input == "binary"){
+    binary_in.reset(new BinaryEventReader(file_in));
+    if(!binary_in->isOpen()){
+      std::cout<<"Could not open "<<file_in<<" as a binary event file"<<std::endl;
+      return 1;
+    }
+  }
+  else if(opt.input == "dat" && opt.reader == "fast"){
+    fast_in.reset(new FastDatReader(file_in));
+    if(!fast_in->isOpen()){
+      std::cout<<"Could not open "<<file_in<<std::endl;
+      return 1;
+    }
+  }
+  else{
+    file.open(file_in);
+    if(!file.is_open()){
+      std::cout<<"Could not open "<<file_in<<std::endl;
+      return 1;
+    }
+  }
 
-  // Create Tree that reads file
-  TTree* t = new TTree("ntuple_thrown_raw","");
-  // Make the tree read the .dat file
-  t->ReadFile(file_in,"event_index/D:PID:parent_PID:Px:Py:Pz:E:x:y:z");
+  // Trees kept in memory (the output is opened last), deleted after the file is closed
+  std::unique_ptr<TTree> t, memory_trees[4];
 
-  // Create final ntuples
-  TNtuple* ntuple_thrown_electrons	= new TNtuple("ntuple_thrown_electrons","","Q2:x_{bjorken}:#nu:W:y:#theta:#phi:p:p_{x}:p_{y}:p_{z}:vz");
-  TNtuple* ntuple_thrown	         	= new TNtuple("ntuple_thrown"          ,"","Q2:x_{bjorken}:#nu:W:y:z_{h}:Pt2:Pl2:#theta_{PQ}:#phi_{PQ}:#theta:#phi:p:p_{x}:p_{y}:p_{z}:#theta_{el}:#phi_{el}:p_{el}:p_{xel}:p_{yel}:p_{zel}:pid");
-  
-  //Process the tree
-  Double_t event_index, PID, parent_PID, Px, Py, Pz, E, x, y, z;
-  Double_t elP[3];
-  setBranchesAddresses(t, &event_index, &PID, &parent_PID, &Px, &Py, &Pz, &E, &x, &y, &z);
-
-  Int_t Nentries = t->GetEntries();
-  for(Int_t entry1 = 0 ; entry1 < Nentries ; entry1++){
-    t->GetEntry(entry1);
-    if(PID==11 && parent_PID==0){
-      // Calculate leptonic variables
-      LeptonicKinematics lk(Px,Py,Pz);
-      elP[0] = Px;
-      elP[1] = Py;
-      elP[2] = Pz;
-
-      ntuple_thrown_electrons->Fill(lk.getQ2(), lk.getXb(), lk.getNu(), lk.getW(), lk.gety(), lk.getThetaLab_el(), lk.getPhiLab_el(), lk.getP_el(), Px, Py, Pz, z);
+  // In streaming mode the output is opened first so the ntuples live in it and their baskets
+  // are flushed to disk while converting. RNTuples are always written while converting
+  bool       open_first = opt.stream || opt.backend == "rntuple";
+  OutputFile f;
+  if(open_first){
+    f.reset(new TFile(file_out,"RECREATE","",getCompressionSettings(opt)));
+    if(f->IsZombie()){
+      std::cout<<"Could not create "<<file_out<<std::endl;
+      return 1;
     }
-    else if(PID != 11 && PID != 22 && PID !=-11){
-      // Calculate hadronic variables
-      LeptonicKinematics lk(elP[0],elP[1],elP[2]);
-      HadronicKinematics hk(Px,Py,Pz,PID);
+    f->cd();
+  }
 
-      float vars_h[23] = {(float) lk.getQ2(), (float) lk.getXb(), (float) lk.getNu(), (float) lk.getW(), (float) lk.gety(), (float) hk.getZh(&lk), (float) hk.getPt2(&lk),
-			  (float) hk.getPl2(&lk), (float) hk.getThetaPQ(&lk), (float) hk.getPhiPQ(&lk), (float) hk.getThetaLab_h(),
-			  (float) hk.getPhiLab_h(), (float) hk.getP_h(), (float) hk.getPx_h(), (float) hk.getPy_h(), (float) hk.getPz_h(),
-			  (float) lk.getThetaLab_el(), (float) lk.getPhiLab_el(), (float) lk.getP_el(), (float) lk.getPx_el(), (float) lk.getPy_el(), (float) lk.getPz_el(), (float) PID};
+  // Histograms filled while converting
+  std::vector<HistogramConfig> histogram_configs;
+  if(!opt.histograms.empty() && !readHistogramConfig(opt.histograms, histogram_configs)) return 1;
+  std::unique_ptr<HistogramSet> histograms(histogram_configs.empty() ? 0 : new HistogramSet(histogram_configs));
+
+  // Selection of the rows written
+  Selection selection;
+  if(!opt.select.empty() && !selection.compile(opt.select)) return 1;
+  const Selection* cuts = opt.select.empty() ? 0 : &selection;
+
+  // Create final ntuples
+  std::unique_ptr<ThrownOutput> output(bookThrownOutput(opt, f.get(), histograms.get(), cuts));
+  output->setReport(report);
+  TTree* ntuple_thrown           = output->getHadronTree();
+  TTree* ntuple_thrown_electrons = output->getElectronTree();
+  TTree* ntuple_thrown_raw       = output->getRawTree();
+  TTree* ntuple_thrown_events    = output->getEventTree();
+  if(!open_first){
+    // In streaming mode the ntuples belong to the file and are deleted when closing it
+    memory_trees[0].reset(ntuple_thrown);
+    memory_trees[1].reset(ntuple_thrown_electrons);
+    memory_trees[2].reset(ntuple_thrown_raw);
+    memory_trees[3].reset(ntuple_thrown_events);
+  }
 
-      ntuple_thrown->Fill(vars_h);
+  if(opt.stream && opt.auto_flush == 0 && ntuple_thrown){
+    // Split the memory ceiling between the ntuples according to their row size (12 vs 23 floats, 10 raw columns)
+    Long64_t max_bytes = (Long64_t) (opt.max_memory*1024.*1024.);
+    Long64_t row_sizes = ntuple_thrown_raw ? 45 : 35;
+    ntuple_thrown->SetAutoFlush(-(max_bytes*23/row_sizes));
+    ntuple_thrown_electrons->SetAutoFlush(-(max_bytes*12/row_sizes));
+    if(ntuple_thrown_raw) ntuple_thrown_raw->SetAutoFlush(-(max_bytes*10/row_sizes));
+  }
+  else if(opt.stream && opt.auto_flush == 0 && ntuple_thrown_events){
+    // Event schema : the hadron and electron columns share one tree
+    Long64_t max_bytes = (Long64_t) (opt.max_memory*1024.*1024.);
+    Long64_t row_sizes = ntuple_thrown_raw ? 45 : 35;
+    ntuple_thrown_events->SetAutoFlush(-(max_bytes*35/row_sizes));
+    if(ntuple_thrown_raw) ntuple_thrown_raw->SetAutoFlush(-(max_bytes*10/row_sizes));
+  }
+
+  std::unique_ptr<LundWriter> lund;
+  if(!opt.lund_out.empty()){
+    lund.reset(new LundWriter(opt.lund_out.c_str(), opt.beam_energy, opt.beam_energy_text));
+    if(!lund->isOpen()){
+      std::cout<<"Could not open "<<opt.lund_out<<std::endl;
+      return 1;
     }
   }
 
+  std::unique_ptr<BinaryEventWriter> binary_out;
+  if(!opt.binary_out.empty()){
+    binary_out.reset(new BinaryEventWriter(opt.binary_out.c_str(), opt.beam_energy));
+    if(!binary_out->isOpen()){
+      std::cout<<"Could not open "<<opt.binary_out<<std::endl;
+      return 1;
+    }
+  }
+
+  // Positions of the LUND events, written next to the LUND file (event_index.h)
+  EventIndex lund_index(kIndexLund);
+  if(lund && opt.index) lund->setIndex(&lund_index);
+
+  TTree* raw_tree = 0;
+  convertInput(opt, run, *in, binary_in.get(), fast_in.get(), output.get(), cuts, lund.get(), binary_out.get(), raw_tree);
+  t.reset(raw_tree);
+  StageTimer close_timer(report, kStageWrite);
+  bool write_index = lund && opt.index;
+  bool lund_failed = lund && !lund->close();
+  lund.reset();
+  if(lund_failed) std::cout<<"Could not write "<<opt.lund_out<<std::endl;
+  if(write_index && !lund_failed && !lund_index.write(getIndexName(opt.lund_out), opt.lund_out)){
+    std::cout<<"Could not write "<<getIndexName(opt.lund_out)<<", build it with event_index"<<std::endl;
+  }
+  bool binary_failed = binary_out && !binary_out->close();
+  if(binary_failed) std::cout<<"Could not write "<<opt.binary_out<<std::endl;
+  bool truncated = compressed_in && compressed_in->hasFailed();
+  compressed_in.reset();
+  if(truncated){
+    std::cout<<"Could not decompress "<<file_in<<" to the end, it is corrupt or truncated"<<std::endl;
+    return 1;
+  }
+  binary_out.reset();
+  binary_in.reset();
+  fast_in.reset();
+
   // Create target root file
-  TFile* f = new TFile(file_out,"RECREATE");
+  if(!f) f.reset(new TFile(file_out,"RECREATE","",getCompressionSettings(opt)));
+  close_timer.stop();
 
+  // Trees kept in memory compress all their baskets when written
+  StageTimer write_timer(report, open_first ? kStageWrite : kStageCompress);
   f->cd();
-  //  t->Write();
-  ntuple_thrown->Write();
-  ntuple_thrown_electrons->Write();
-  f->Close();
-  
-  gROOT->cd();
-  delete f;
-  delete t;
-  delete ntuple_thrown;
-  delete ntuple_thrown_electrons;
+  output->write();
+  output.reset();
+  if(histograms) histograms->write();
+  histograms.reset();
+  write_timer.stop();
+
+  StageTimer file_timer(report, kStageWrite);
+  f.reset();
+  t.reset();
+  for(std::unique_ptr<TTree>& tree : memory_trees) tree.reset();
+
+  return (lund_failed || binary_failed) ? 1 : 0;
+}
+
+template<class Run>
+int convert(const Options& opt, const Run& run, JobReport* report){
+  if(opt.merge)       return convertMerge(opt, run, report);
+  if(opt.shards > 1)  return convertShards(opt, run, report);
+  if(opt.threads > 1) return convertParallel(opt, run, report);
+  return convertSerial(opt, run, report);
+}
+
+int runJob(Options opt, ConversionCache* cache){
+  // Converts the input of opt. With --incremental, cache is the manifest (0 : the one of the output is read)
+  // Returns 0 on success
+  if(isPipeInput(opt) && !openPipeInput(opt)) return 1;
+  if(!isPipeInput(opt) && getCompression(opt.file_in) != kNoCompression && !openCompressedInput(opt)) return 1;
+  std::string report_name = getReportName(opt);
+
+  // Incremental mode : skip the conversion if the manifest has the output up to date, otherwise write it
+  // to <output>.part and record it once renamed
+  ConversionCache* own_cache = 0;
+  std::string      cache_key, file_out = opt.file_out;
+  if(opt.incremental){
+    if(!cache) cache = own_cache = new ConversionCache(getManifestName(opt));
+    cache_key = cache->getKey(opt, opt.merge ? expandInputs(opt.file_in) : std::vector<std::string>(1, opt.file_in));
+    if(cache_key.empty()){
+      std::cout<<"Could not hash the inputs of "<<opt.file_out<<std::endl;
+      delete own_cache;
+      return 1;
+    }
+    bool extra_outputs = (opt.lund_out.empty() || getFileBytes(opt.lund_out) > 0) && (opt.binary_out.empty() || getFileBytes(opt.binary_out) > 0);
+    if(extra_outputs && cache->isCurrent(file_out, cache_key)){
+      std::cout<<file_out<<" is up to date"<<std::endl;
+      cache->savePending();
+      delete own_cache;
+      return 0;
+    }
+    opt.file_out = file_out + ".part";
+  }
+  else cache = 0;
+
+  // Timers and counters of the job, also written when the conversion fails
+  JobReport* report = (opt.report == "none") ? 0 : new JobReport();
+  if(report && !opt.merge) report->addBytesIn(getFileBytes(opt.file_in));
+
+  // Common beam energies use the compile-time constants, anything else the run-time ones
+  int status;
+  if(opt.beam_energy == 11. && opt.target_mass == kMassProton){
+    status = convert(opt, FixedRunConstants<11>(opt.z_vertex), report);
+  }
+  else if(opt.beam_energy == 22. && opt.target_mass == kMassProton){
+    status = convert(opt, FixedRunConstants<22>(opt.z_vertex), report);
+  }
+  else{
+    status = convert(opt, RunConstants(opt.beam_energy, opt.target_mass, opt.z_vertex), report);
+  }
+
+  if(cache){
+    std::string part = opt.file_out;
+    opt.file_out = file_out;
+    if(status == 0 && std::rename(part.c_str(), file_out.c_str()) != 0){
+      std::cout<<"Could not rename "<<part<<" to "<<file_out<<std::endl;
+      status = 1;
+    }
+    if(status == 0 && !cache->record(file_out, cache_key)) std::cout<<"Could not record "<<file_out<<" in "<<getManifestName(opt)<<std::endl;
+    if(status != 0) std::remove(part.c_str());
+    delete own_cache;
+  }
+
+  if(report){
+    if(!report->writeJson(report_name, opt, status)) std::cout<<"Could not write "<<report_name<<std::endl;
+    delete report;
+  }
+  if(status != 0) return status;
+
+  std::cout<<"Peak RSS : "<<getPeakRSS()<<" MB"<<std::endl;
 
   return 0;
 }
+
+int main(int argc, char** argv){
+
+  Options opt;
+  if(!parseOptions(argc, argv, opt)){
+    std::cout<<"Number of arguments is not correct!"<<std::endl;
+    printUsage();
+    return 1;
+  }
+  if(!opt.batch.empty()) return runBatch(argc, argv, opt);
+
+  return runJob(opt, 0);
+}
@@ -0,0 +1,107 @@
+// Random access to the events of .dat and LUND files through their sidecar index (event_index.h)
+// Only needs event_index.h, no ROOT
+
+// usage : ./event_index build <file> [dat|lund]                 writes <file>.idx
+//         ./event_index info <file>                             number of events and particles
+//         ./event_index show <file> <event>                     prints one event
+//         ./event_index extract <file> <first_event> <n_events> [output_file]
+//         ./event_index split <file> <events_per_file> <prefix>  writes <prefix>_<N>.dat (and their indexes)
+// Without an up to date <file>.idx the file is scanned first.
+
+// author : Esteban Molina
+
+#include "event_index.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+void printUsage(){
+  std::printf("Usage : ./event_index build <file> [dat|lund]\n");
+  std::printf("        ./event_index info <file>\n");
+  std::printf("        ./event_index show <file> <event>\n");
+  std::printf("        ./event_index extract <file> <first_event> <n_events> [output_file]\n");
+  std::printf("        ./event_index split <file> <events_per_file> <prefix>\n");
+}
+
+bool writeText(const std::string& file_name, const std::string& text){
+  // Writes text to file_name, or to stdout if file_name is empty
+  FILE* out = file_name.empty() ? stdout : std::fopen(file_name.c_str(), "w");
+  if(!out) return false;
+  bool ok = std::fwrite(text.data(), 1, text.size(), out) == text.size();
+  if(out != stdout) ok = (std::fclose(out) == 0) && ok;
+  return ok;
+}
+
+int main(int argc, char** argv){
+
+  if(argc < 3){
+    printUsage();
+    return 0;
+  }
+  std::string command   = argv[1];
+  std::string file_name = argv[2];
+
+  EventIndex index;
+  if(command == "build"){
+    int format = -1;
+    if(argc > 3) format = (std::string(argv[3]) == "lund") ? kIndexLund : kIndexDat;
+    if(!index.build(file_name, format) || !index.write(getIndexName(file_name), file_name)){
+      std::printf("Could not index %s\n", file_name.c_str());
+      return 1;
+    }
+    std::printf("%s : %llu events, %llu particles (%s)\n", getIndexName(file_name).c_str(), (unsigned long long) index.getNevents(),
+		(unsigned long long) index.getNparticles(), index.getFormat() == kIndexLund ? "LUND" : ".dat");
+    return 0;
+  }
+
+  if(!loadEventIndex(file_name, index)){
+    std::printf("Could not open %s\n", file_name.c_str());
+    return 1;
+  }
+
+  std::string text;
+  if(command == "info"){
+    std::printf("%s : %llu events, %llu particles (%s)\n", file_name.c_str(), (unsigned long long) index.getNevents(),
+		(unsigned long long) index.getNparticles(), index.getFormat() == kIndexLund ? "LUND" : ".dat");
+  }
+  else if(command == "show" && argc > 3){
+    uint64_t event = std::strtoull(argv[3], nullptr, 10);
+    if(event >= index.getNevents()){
+      std::printf("%s has %llu events\n", file_name.c_str(), (unsigned long long) index.getNevents());
+      return 1;
+    }
+    if(!readEventRange(file_name, index, event, event + 1, text) || !writeText("", text)) return 1;
+  }
+  else if(command == "extract" && argc > 4){
+    uint64_t first = std::strtoull(argv[3], nullptr, 10);
+    uint64_t n     = std::strtoull(argv[4], nullptr, 10);
+    std::string output = (argc > 5) ? argv[5] : "";
+    if(!readEventRange(file_name, index, first, first + n, text) || !writeText(output, text)){
+      std::printf("Could not extract the events of %s\n", file_name.c_str());
+      return 1;
+    }
+  }
+  else if(command == "split" && argc > 4){
+    uint64_t    n      = std::strtoull(argv[3], nullptr, 10);
+    std::string prefix = argv[4];
+    if(n == 0){
+      printUsage();
+      return 1;
+    }
+    for(uint64_t first = 0, piece = 0 ; first < index.getNevents() ; first += n, piece++){
+      std::string output = prefix + "_" + std::to_string(piece) + ".dat";
+      EventIndex  piece_index;
+      if(!readEventRange(file_name, index, first, first + n, text) || !writeText(output, text) ||
+	 !piece_index.build(output, index.getFormat()) || !piece_index.write(getIndexName(output), output)){
+	std::printf("Could not write %s\n", output.c_str());
+	return 1;
+      }
+    }
+  }
+  else{
+    printUsage();
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Writes synthetic LEPTO listings or .dat rows (event_generator.h) to the screen, for benchmarks and tests
+// of dat2tuple on inputs of any size. Does not need ROOT.
+
+// usage : ./gen_events <n_events> [--format=lepto|dat] [--multiplicity=<N>] [--beam_energy=<GeV>] [--seed=<N>] [--z_vertex=<cm>]
+//         ./gen_events 1000000 --format=dat > big.dat
+
+// author : Esteban Molina
+
+#include "event_generator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+const long kBlockEvents = 10000;	// events generated in memory before writing them
+
+int main(int argc, char** argv){
+
+  if(argc < 2){
+    std::printf("Usage : ./gen_events <n_events> [--format=lepto|dat] [--multiplicity=<N>] [--beam_energy=<GeV>] [--seed=<N>] [--z_vertex=<cm>]\n");
+    return 0;
+  }
+
+  long          n_events     = std::atol(argv[1]);
+  std::string   format       = "lepto";
+  double        multiplicity = 4.;
+  double        beam_energy  = kEbeam;
+  unsigned long seed         = 12345;
+  double        z_vertex     = 0.;
+  for(int i = 2 ; i < argc ; i++){
+    const char* arg   = argv[i];
+    const char* value = std::strchr(arg, '=');
+    if(!value){
+      std::printf("Unknown option %s\n", arg);
+      return 1;
+    }
+    value++;
+    if(std::strncmp(arg, "--format=", 9) == 0)            format       = value;
+    else if(std::strncmp(arg, "--multiplicity=", 15) == 0) multiplicity = std::atof(value);
+    else if(std::strncmp(arg, "--beam_energy=", 14) == 0)  beam_energy  = std::atof(value);
+    else if(std::strncmp(arg, "--seed=", 7) == 0)          seed         = std::strtoul(value, nullptr, 10);
+    else if(std::strncmp(arg, "--z_vertex=", 11) == 0)     z_vertex     = std::atof(value);
+    else{
+      std::printf("Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+  if(n_events <= 0 || multiplicity <= 0. || beam_energy <= 0. || (format != "lepto" && format != "dat")){
+    std::printf("Wrong n_events, multiplicity, beam energy or format\n");
+    return 1;
+  }
+
+  EventGenerator generator(seed, beam_energy, multiplicity);
+  std::string listing, rows;
+  if(format == "lepto") generator.header(listing);
+
+  int last_event = 0;
+  for(long first = 0 ; first < n_events ; first += kBlockEvents){
+    long n = (n_events - first < kBlockEvents) ? n_events - first : kBlockEvents;
+    for(long i = 0 ; i < n ; i++) generator.generate(listing);
+
+    if(format == "lepto"){
+      std::fwrite(listing.data(), 1, listing.size(), stdout);
+    }
+    else{
+      last_event = listingToDat(listing, z_vertex, rows, last_event);
+      std::fwrite(rows.data(), 1, rows.size(), stdout);
+      rows.clear();
+    }
+    listing.clear();
+  }
+
+  return 0;
+}
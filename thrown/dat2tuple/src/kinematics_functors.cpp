@@ -0,0 +1,134 @@
+// Definitions of the RDataFrame functors of kinematics_functors.h, built as bin/libThrownKinematics.so (make lib)
+// The electron variables come from LeptonicKinematics and the hadron ones from VirtualPhotonFrame (kinematics.h), the
+// code of dat2tuple --kinematics=fused (checked against HadronicKinematics by check_kinematics)
+
+// author : Esteban Molina
+
+#include "kinematics_functors.h"
+#include "kinematics.h"
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+enum KinematicsVariable{kVarQ2, kVarXb, kVarNu, kVarW, kVary, kVarZh, kVarPt2, kVarPl2, kVarCosThetaPQ, kVarThetaPQ, kVarPhiPQ,
+			kVarTheta, kVarPhi, kVarP, kNkinematicsVariables};
+
+const char* const kKinematicsVariables[kNkinematicsVariables] = {"Q2", "Xb", "Nu", "W", "y", "Zh", "Pt2", "Pl2", "CosThetaPQ",
+								  "ThetaPQ", "PhiPQ", "Theta", "Phi", "P"};
+
+//####################################################################################################################//
+//########################################       COMMON FUNCTIONS        #############################################//
+//####################################################################################################################//
+
+int getKinematicsVariable(const std::string& name, bool hadron){
+  // Position of the variable in kKinematicsVariables, kNkinematicsVariables if the functor does not compute it
+  for(int i = 0 ; i < kNkinematicsVariables ; i++){
+    if(name == kKinematicsVariables[i] && (hadron || i < kVarZh || i >= kVarTheta)) return i;
+  }
+  std::cout<<"Unknown "<<(hadron ? "hadron" : "electron")<<" variable "<<name<<std::endl;
+  return kNkinematicsVariables;
+}
+
+double getElectronValue(int variable, LeptonicKinematics<RunConstants>& lk){
+  switch(variable){
+  case kVarQ2:    return lk.getQ2();
+  case kVarXb:    return lk.getXb();
+  case kVarNu:    return lk.getNu();
+  case kVarW:     return lk.getW();
+  case kVary:     return lk.gety();
+  case kVarTheta: return lk.getThetaLab_el();
+  case kVarPhi:   return lk.getPhiLab_el();
+  case kVarP:     return lk.getP_el();
+  }
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
+double getHadronValue(int variable, const HadronFrameVars& h){
+  switch(variable){
+  case kVarZh:         return h.Zh;
+  case kVarPt2:        return h.Pt2;
+  case kVarPl2:        return h.Pl2;
+  case kVarCosThetaPQ: return h.CosThetaPQ;
+  case kVarThetaPQ:    return h.ThetaPQ;
+  case kVarPhiPQ:      return h.PhiPQ;
+  case kVarTheta:      return h.ThetaLab_h;
+  case kVarPhi:        return h.PhiLab_h;
+  case kVarP:          return h.P_h;
+  }
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
+//####################################################################################################################//
+//########################################       METHOD DEFINITIONS      #############################################//
+//####################################################################################################################//
+
+template<class T>
+ElectronVariable<T>::ElectronVariable(const std::string& name, double E, double M) : variable(getKinematicsVariable(name, false)),
+										      beam_energy(E), target_mass(M){}
+
+template<class T>
+ElectronVariable<T>::~ElectronVariable(){}
+
+template<class T>
+double ElectronVariable<T>::operator()(T Px_el, T Py_el, T Pz_el) const{
+  LeptonicKinematics<RunConstants> lk(Px_el, Py_el, Pz_el, RunConstants(beam_energy, target_mass));
+  return getElectronValue(variable, lk);
+}
+
+template<class T, class P>
+HadronVariable<T, P>::HadronVariable(const std::string& name, double E, double M) : variable(getKinematicsVariable(name, true)),
+										     beam_energy(E), target_mass(M){}
+
+template<class T, class P>
+HadronVariable<T, P>::~HadronVariable(){}
+
+template<class T, class P>
+double HadronVariable<T, P>::operator()(T Px_el, T Py_el, T Pz_el, T Px, T Py, T Pz, P pid) const{
+  LeptonicKinematics<RunConstants> lk(Px_el, Py_el, Pz_el, RunConstants(beam_energy, target_mass));
+  // Variables of the electron do not need the frame
+  if(variable < kVarZh) return getElectronValue(variable, lk);
+
+  HadronFrameVars h;
+  VirtualPhotonFrame<RunConstants>(lk).compute(Px, Py, Pz, HadronicKinematics<RunConstants>::getMass_h(pid), h);
+  return getHadronValue(variable, h);
+}
+
+template<class T, class P>
+HadronArrayVariable<T, P>::HadronArrayVariable(const std::string& name, double E, double M) : variable(getKinematicsVariable(name, true)),
+											       beam_energy(E), target_mass(M){}
+
+template<class T, class P>
+HadronArrayVariable<T, P>::~HadronArrayVariable(){}
+
+template<class T, class P>
+ROOT::RVec<double> HadronArrayVariable<T, P>::operator()(T Px_el, T Py_el, T Pz_el, const ROOT::RVec<T>& Px, const ROOT::RVec<T>& Py,
+							   const ROOT::RVec<T>& Pz, const ROOT::RVec<P>& pid) const{
+  // The electron kinematics and the frame once per event
+  LeptonicKinematics<RunConstants> lk(Px_el, Py_el, Pz_el, RunConstants(beam_energy, target_mass));
+  ROOT::RVec<double> values(Px.size());
+  if(variable < kVarZh){
+    double value = getElectronValue(variable, lk);
+    for(size_t i = 0 ; i < values.size() ; i++) values[i] = value;
+    return values;
+  }
+
+  VirtualPhotonFrame<RunConstants> frame(lk);
+  HadronFrameVars h;
+  for(size_t i = 0 ; i < values.size() ; i++){
+    frame.compute(Px[i], Py[i], Pz[i], HadronicKinematics<RunConstants>::getMass_h(pid[i]), h);
+    values[i] = getHadronValue(variable, h);
+  }
+  return values;
+}
+
+template class ElectronVariable<float>;
+template class ElectronVariable<double>;
+template class HadronVariable<float, int>;
+template class HadronVariable<float, float>;
+template class HadronVariable<double, int>;
+template class HadronVariable<double, double>;
+template class HadronArrayVariable<float, int>;
+template class HadronArrayVariable<float, float>;
+template class HadronArrayVariable<double, int>;
+template class HadronArrayVariable<double, double>;
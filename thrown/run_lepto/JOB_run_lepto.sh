@@ -57,7 +57,7 @@ executable_file_check(){
     # checking dat2tuple executable existence
     if [[ ! -f ${dat2tuple_dir}/bin/dat2tuple ]]
     then
-	echo "The dat2tuple executable does not exist"
+	echo "The dat2tuple executable does not exist, build it with make in ${dat2tuple_dir}"
 	exit 1
     fi
 }
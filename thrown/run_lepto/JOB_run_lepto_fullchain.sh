@@ -66,7 +66,7 @@ executable_file_check(){
     # checking dat2tuple executable existence
     if [[ ! -f ${dat2tuple_dir}/bin/dat2tuple ]]
     then
-	echo "The dat2tuple executable does not exist"
+	echo "The dat2tuple executable does not exist, build it with make in ${dat2tuple_dir}"
 	exit 1
     fi
 }
@@ -111,17 +111,11 @@ AZ_assignation ${target}
 echo "${Nevents} ${A} ${Z}" > lepto_input.txt
 lepto_${id}.exe < lepto_input.txt > ${lepto_out}.txt
 
-cp ${lepto2dat_dir}/lepto2dat.pl ${temp_dir}/
-perl lepto2dat.pl ${z_vertex} < ${lepto_out}.txt > ${lepto_out}.dat
-
+# Obtain the ntuples and the LUND formated output from the same pass
+LUND_lepto_out=LUND${lepto_out}
 executable_file_check
 cp ${dat2tuple_dir}/bin/dat2tuple ${temp_dir}/
-./dat2tuple ${lepto_out}.dat ${lepto_out}_ntuple.root
-
-# Obtain LUND formated output
-LUND_lepto_out=LUND${lepto_out}
-cp ${rec_utils_dir}/leptoLUND.pl ${temp_dir}/
-perl leptoLUND.pl ${z_vertex} ${beam_energy} < ${lepto_out}.txt > ${LUND_lepto_out}.dat
+./dat2tuple ${lepto_out}.txt ${lepto_out}_ntuple.root --input=lepto --z_vertex=${z_vertex} --lund=${LUND_lepto_out}.dat --beam_energy=${beam_energy}
 
 # Move output to its folder
 #mv ${LUND_lepto_out}.dat ${lepto_out}_ntuple.root ${out_dir}/
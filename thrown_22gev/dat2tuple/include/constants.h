@@ -1,20 +0,0 @@
-// Constants
-const double kEbeam		= 22.;
-const double kMassGamma		= 0.000000;
-const double kMassPositron	= 5.109998e-4;
-const double kMassElectron	= 5.109998e-4;
-const double kMassNeutrino	= 0.000000;
-const double kMassMuonPlus	= 0.105658;
-const double kMassMuonMinus	= 0.105658;
-const double kMassPiZero	= 0.134977;
-const double kMassPiPlus	= 0.139570;
-const double kMassPiMinus	= 0.139570;
-const double kMassKaonZeroLong	= 0.497614;
-const double kMassKaonPlus	= 0.493677;
-const double kMassKaonMinus	= 0.493677;
-const double kMassNeutron	= 0.939565;
-const double kMassProton	= 0.938272;
-const double kMassKaonZeroShort	= 0.497614;
-const double kMassEta		= 0.547853;
-const double kMassOmega		= 0.782650;
-const double kMassKaonZero	= 0.497614;
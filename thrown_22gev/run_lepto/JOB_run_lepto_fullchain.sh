@@ -66,16 +66,17 @@ executable_file_check(){
     # checking dat2tuple executable existence
     if [[ ! -f ${dat2tuple_dir}/bin/dat2tuple ]]
     then
-	echo "The dat2tuple executable does not exist"
+	echo "The dat2tuple executable does not exist, build it with make in ${dat2tuple_dir}"
 	exit 1
     fi
 }
 
 ## DIRECTORIES
+main_dir=$(pwd)
 LEPTO_dir=~/Lepto64Sim_22gev/bin ## CHECK THIS DIRECTORY!
 execution_dir=/volatile/clas12/emolinac
 lepto2dat_dir=${main_dir}/thrown_22gev/lepto2dat
-dat2tuple_dir=${main_dir}/thrown_22gev/dat2tuple
+dat2tuple_dir=${main_dir}/thrown/dat2tuple ## same binary as 11 GeV, the beam energy is passed at run time
 
 out_dir=/work/clas12/rg-e/emolinac/lepto_22gev
 
@@ -103,18 +104,16 @@ cp ${LEPTO_dir}/lepto.exe ${temp_dir}/lepto_${id}.exe
 
 # Execution 
 lepto_out=lepto_out_${id}
+beam_energy=22
 z_vertex=0.
 
 AZ_assignation ${target}
 echo "${Nevents} ${A} ${Z}" > lepto_input.txt
 lepto_${id}.exe < lepto_input.txt > ${lepto_out}.txt
 
-cp ${lepto2dat_dir}/lepto2dat.pl ${temp_dir}/
-perl lepto2dat.pl ${z_vertex} < ${lepto_out}.txt > ${lepto_out}.dat
-
 executable_file_check
 cp ${dat2tuple_dir}/bin/dat2tuple ${temp_dir}/
-./dat2tuple ${lepto_out}.dat ${lepto_out}_ntuple.root
+./dat2tuple ${lepto_out}.txt ${lepto_out}_ntuple.root --input=lepto --z_vertex=${z_vertex} --beam_energy=${beam_energy}
 
 # Move output to its folder
 #mv ${lepto_out}.dat ${lepto_out}_ntuple.root ${out_dir}/